@@ -1,65 +1,43 @@
 #include <iostream>
-#include <filesystem>
 #include <vector>
-#include <thread>
-#include <mutex>
-#include <taglib/fileref.h>
-#include <taglib/tag.h>
-#include <taglib/audioproperties.h>
 #include <string>
-
-namespace fs = std::filesystem;
-
-// Mutex to synchronise console output
-std::mutex outputMutex;
+#include "../../media_formats/audiometadata/audiometadata.h"
 
 // MetadataExtractor class scans a directory and extracts audio metadata from files concurrently
 class MetadataExtractor
 {
 public:
-    // Scans the given directory and spawns a thread for each regular file to process metadata
+    // Collects the regular files of the given directory and hands them to the shared
+    // audiometadata thread pool, which processes them with a bounded number of workers
     void scan_directory(const std::string& path)
     {
-        std::vector<std::thread> threads;
-
-        for (const auto& entry : fs::directory_iterator(path))
-        {
-            if (fs::is_regular_file(entry))
-            {
-                threads.emplace_back(&MetadataExtractor::process_file, this, entry.path().string());
-            }
-        }
+        std::vector<std::string> files = audiometadata::collectAudioFiles(path, false);
+        std::vector<AudioMetadata> results = audiometadata::extractAll(files);
 
-        for (auto& t : threads)
+        // Results are printed once all workers have finished, so no output locking is required
+        for (const auto& meta : results)
         {
-            t.join();
+            print_metadata(meta);
         }
     }
 
 private:
-    // Processes a single file by extracting and printing its audio metadata
-    void process_file(const std::string& filepath)
+    // Prints the extracted audio metadata of a single file
+    void print_metadata(const AudioMetadata& meta)
     {
-        TagLib::FileRef file(filepath.c_str());
-        if (!file.isNull() && file.tag() && file.audioProperties())
+        if (meta.valid)
         {
-            // Lock output to avoid interleaving output from multiple threads
-            std::lock_guard<std::mutex> lock(outputMutex);
-            auto* tag = file.tag();
-            auto* properties = file.audioProperties();
-
-            std::cout << "File: " << filepath << "\n";
-            std::cout << "Artist: " << tag->artist().to8Bit(true) << "\n";
-            std::cout << "Album: " << tag->album().to8Bit(true) << "\n";
-            std::cout << "Title: " << tag->title().to8Bit(true) << "\n";
-            std::cout << "Year: " << tag->year() << "\n";
-            std::cout << "Duration: " << properties->lengthInSeconds() << " sec\n";
+            std::cout << "File: " << meta.filepath << "\n";
+            std::cout << "Artist: " << meta.artist << "\n";
+            std::cout << "Album: " << meta.album << "\n";
+            std::cout << "Title: " << meta.title << "\n";
+            std::cout << "Year: " << meta.year << "\n";
+            std::cout << "Duration: " << meta.durationSeconds << " sec\n";
             std::cout << "---------------------------------------\n";
         }
         else
         {
-            std::lock_guard<std::mutex> lock(outputMutex);
-            std::cerr << "Error: Could not read metadata for " << filepath << "\n";
+            std::cerr << "Error: Could not read metadata for " << meta.filepath << "\n";
         }
     }
 };
@@ -0,0 +1,291 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "diskusagescanner.h"
+
+extern "C"
+{
+    #include <sys/mman.h>
+}
+
+// Snapshot file layout (host byte order):
+//   SnapshotHeader
+//   SnapshotNode[nodeCount]      nodes in breadth-first order, so every node's children are contiguous
+//   char[stringTableSize]        concatenated entry names, not NUL-terminated
+// A mapped snapshot is usable as is: loading it costs one mmap, a header check and one sequential
+// bounds check over the nodes, with no parsing or allocation
+struct SnapshotHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t nodeCount;
+    uint64_t stringTableSize;
+    int64_t createdAt;          // Unix time of the scan
+};
+
+struct SnapshotNode
+{
+    uint32_t parent;
+    uint32_t firstChild;        // Index of the first child; children occupy [firstChild, firstChild + childCount)
+    uint32_t childCount;
+    uint32_t nameLength;
+    uint64_t nameOffset;        // Offset of the name in the string table
+    uint64_t size;              // Cumulative apparent size in bytes
+    uint64_t allocated;         // Cumulative allocated size in bytes
+    uint64_t fileCount;         // Cumulative number of regular files
+};
+
+// DiskSnapshot saves a scanned DirectoryTree to a compact binary file and maps saved files back read-only
+class DiskSnapshot
+{
+public:
+    static constexpr char Magic[8] = { 'D', 'U', 'S', 'N', 'A', 'P', '\0', '\0' };
+    static constexpr uint32_t Version = 1;
+
+    // Writes 'tree' in breadth-first order. Returns false on I/O errors
+    static bool save(const DirectoryTree& tree, const std::string& filepath)
+    {
+        // Breadth-first order places the children of every node next to each other
+        std::vector<uint32_t> order;
+        order.reserve(tree.size());
+        if (tree.size() > 0)
+        {
+            order.push_back(0);
+        }
+        std::vector<SnapshotNode> nodes(tree.size());
+        std::vector<uint32_t> newIndex(tree.size());
+        std::string strings;
+
+        for (size_t i = 0; i < order.size(); ++i)
+        {
+            uint32_t id = order[i];
+            newIndex[id] = static_cast<uint32_t>(i);
+            const DirectoryNode& source = tree.node(id);
+
+            SnapshotNode& node = nodes[i];
+            node.parent = i == 0 ? 0 : newIndex[source.parent];
+            node.nameOffset = strings.size();
+            node.nameLength = static_cast<uint32_t>(source.name.size());
+            node.size = source.size;
+            node.allocated = source.allocated;
+            node.fileCount = source.fileCount;
+            strings += source.name;
+
+            auto children = tree.children(id);
+            node.firstChild = static_cast<uint32_t>(order.size());
+            node.childCount = static_cast<uint32_t>(children.second - children.first);
+            order.insert(order.end(), children.first, children.second);
+        }
+
+        SnapshotHeader header{};
+        std::memcpy(header.magic, Magic, sizeof(Magic));
+        header.version = Version;
+        header.nodeCount = static_cast<uint32_t>(nodes.size());
+        header.stringTableSize = strings.size();
+        header.createdAt = static_cast<int64_t>(std::time(nullptr));
+
+        std::ofstream out(filepath, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(nodes.data()), static_cast<std::streamsize>(nodes.size() * sizeof(SnapshotNode)));
+        out.write(strings.data(), static_cast<std::streamsize>(strings.size()));
+        return static_cast<bool>(out);
+    }
+
+    // Maps a snapshot file; check isOpen() before use
+    explicit DiskSnapshot(const std::string& filepath)
+    {
+        int fd = ::open(filepath.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+        {
+            return;
+        }
+        struct stat st;
+        if (::fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) >= sizeof(SnapshotHeader))
+        {
+            void* ptr = ::mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (ptr != MAP_FAILED)
+            {
+                m_data = static_cast<const char*>(ptr);
+                m_size = static_cast<size_t>(st.st_size);
+            }
+        }
+        ::close(fd);
+
+        if (m_data && !validate())
+        {
+            ::munmap(const_cast<char*>(m_data), m_size);
+            m_data = nullptr;
+        }
+    }
+
+    ~DiskSnapshot()
+    {
+        if (m_data)
+        {
+            ::munmap(const_cast<char*>(m_data), m_size);
+        }
+    }
+
+    DiskSnapshot(const DiskSnapshot&) = delete;
+    DiskSnapshot& operator=(const DiskSnapshot&) = delete;
+
+    bool isOpen() const { return m_data != nullptr; }
+    uint32_t nodeCount() const { return header().nodeCount; }
+    int64_t createdAt() const { return header().createdAt; }
+    const SnapshotNode& node(uint32_t id) const { return m_nodes[id]; }
+
+    std::string_view name(uint32_t id) const
+    {
+        return std::string_view(m_strings + m_nodes[id].nameOffset, m_nodes[id].nameLength);
+    }
+
+    // Rebuilds the full path of a node from the names along its parent chain
+    std::string path(uint32_t id) const
+    {
+        std::vector<uint32_t> chain;
+        for (; id != 0; id = m_nodes[id].parent)
+        {
+            chain.push_back(id);
+        }
+        fs::path result(std::string(name(0)));
+        for (auto it = chain.rbegin(); it != chain.rend(); ++it)
+        {
+            result /= std::string(name(*it));
+        }
+        return result.string();
+    }
+
+private:
+    const char* m_data{ nullptr };
+    size_t m_size{ 0 };
+    const SnapshotNode* m_nodes{ nullptr };
+    const char* m_strings{ nullptr };
+
+    const SnapshotHeader& header() const
+    {
+        return *reinterpret_cast<const SnapshotHeader*>(m_data);
+    }
+
+    // Checks the magic, version and section sizes, so that later accesses stay inside the mapping
+    bool validate()
+    {
+        const SnapshotHeader& h = header();
+        if (std::memcmp(h.magic, Magic, sizeof(Magic)) != 0 || h.version != Version || h.nodeCount == 0)
+        {
+            return false;
+        }
+        size_t nodesBytes = static_cast<size_t>(h.nodeCount) * sizeof(SnapshotNode);
+        if (sizeof(SnapshotHeader) + nodesBytes + h.stringTableSize != m_size)
+        {
+            return false;
+        }
+        m_nodes = reinterpret_cast<const SnapshotNode*>(m_data + sizeof(SnapshotHeader));
+        m_strings = m_data + sizeof(SnapshotHeader) + nodesBytes;
+
+        // Every index and name must lie inside the file, so a damaged snapshot is rejected here rather
+        // than read out of bounds later. Parents are written before their children, so a parent must come
+        // before its node and children after it; anything else could make path() or the diff loop forever.
+        // One sequential pass over the mapped nodes
+        for (uint32_t i = 0; i < h.nodeCount; ++i)
+        {
+            const SnapshotNode& node = m_nodes[i];
+            if ((i != 0 && node.parent >= i) || node.firstChild <= i || node.firstChild > h.nodeCount ||
+                node.childCount > h.nodeCount - node.firstChild ||
+                node.nameOffset > h.stringTableSize || node.nameLength > h.stringTableSize - node.nameOffset)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+// SnapshotDiff compares two snapshots of the same tree by matching directories by name, level by level
+class SnapshotDiff
+{
+public:
+    struct Growth
+    {
+        uint32_t node;          // Node index in the newer snapshot
+        int64_t delta;          // Change in allocated bytes
+    };
+
+    // Returns the subtrees that grew the most. A directory is only reported when no single child
+    // accounts for 80% or more of its growth; otherwise the child is the real hotspot and the
+    // parent would just repeat it
+    static std::vector<Growth> hotspots(const DiskSnapshot& older, const DiskSnapshot& newer, size_t limit)
+    {
+        std::vector<int64_t> delta = computeDeltas(older, newer);
+
+        std::vector<int64_t> largestChild(newer.nodeCount(), 0);
+        for (uint32_t id = 1; id < newer.nodeCount(); ++id)
+        {
+            int64_t& largest = largestChild[newer.node(id).parent];
+            largest = std::max(largest, delta[id]);
+        }
+
+        std::vector<Growth> result;
+        for (uint32_t id = 0; id < newer.nodeCount(); ++id)
+        {
+            if (delta[id] > 0 && largestChild[id] * 10 < delta[id] * 8)
+            {
+                result.push_back({ id, delta[id] });
+            }
+        }
+
+        auto byGrowth = [](const Growth& a, const Growth& b) { return a.delta > b.delta; };
+        if (result.size() > limit)
+        {
+            std::partial_sort(result.begin(), result.begin() + static_cast<std::ptrdiff_t>(limit), result.end(), byGrowth);
+            result.resize(limit);
+        }
+        else
+        {
+            std::sort(result.begin(), result.end(), byGrowth);
+        }
+        return result;
+    }
+
+    // Computes the allocated-size change of every node of 'newer'. New directories count entirely as growth
+    static std::vector<int64_t> computeDeltas(const DiskSnapshot& older, const DiskSnapshot& newer)
+    {
+        constexpr uint32_t NoMatch = UINT32_MAX;
+        std::vector<int64_t> delta(newer.nodeCount(), 0);
+        std::vector<std::pair<uint32_t, uint32_t>> stack{ { 0, 0 } };      // (older node, newer node)
+        std::unordered_map<std::string_view, uint32_t> olderChildren;
+
+        while (!stack.empty())
+        {
+            auto [oldId, newId] = stack.back();
+            stack.pop_back();
+
+            const SnapshotNode& current = newer.node(newId);
+            int64_t before = oldId == NoMatch ? 0 : static_cast<int64_t>(older.node(oldId).allocated);
+            delta[newId] = static_cast<int64_t>(current.allocated) - before;
+
+            olderChildren.clear();
+            if (oldId != NoMatch)
+            {
+                const SnapshotNode& previous = older.node(oldId);
+                for (uint32_t c = previous.firstChild; c < previous.firstChild + previous.childCount; ++c)
+                {
+                    olderChildren.emplace(older.name(c), c);
+                }
+            }
+            for (uint32_t c = current.firstChild; c < current.firstChild + current.childCount; ++c)
+            {
+                auto it = olderChildren.find(newer.name(c));
+                stack.emplace_back(it == olderChildren.end() ? NoMatch : it->second, c);
+            }
+        }
+        return delta;
+    }
+};
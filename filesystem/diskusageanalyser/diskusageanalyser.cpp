@@ -4,55 +4,373 @@
 #include <algorithm>
 #include <iomanip>
 #include <string>
-
-namespace fs = std::filesystem;
+#include <cstdint>
+#include <cerrno>
+#include <cstring>
+#include <cctype>
+#include <stdexcept>
+#include "diskusagescanner.h"
+#include "disksnapshot.h"
+#include "reportwriter.h"
 
 // DiskUsageAnalyser class scans directories recursively and displays file sizes
 // It paginates the output to show a limited number of files at a time
 class DiskUsageAnalyser
 {
 public:
+    explicit DiskUsageAnalyser(const ScanOptions& options = ScanOptions()) : m_options(options)
+    {
+    }
+
     // Scans the given directory, collects file paths and sizes, sorts them,
-    // and displays them in a paginated manner
+    // and displays them in a paginated manner. The scan is the same as in the other modes, so
+    // hardlinks are counted once and -x and --apparent-size apply
     void analyseDirectory(const std::string& path)
     {
+        DirectoryTree tree;
+        FileList list;
+        if (!buildTree(path, tree, nullptr, &list))
+        {
+            return;
+        }
+
+        // Check if any files were found
+        if (list.empty())
+        {
+            std::cout << "No files found in the directory." << std::endl;
+            return;
+        }
+
+        // Sort files in descending order by size
+        list.sort(m_options.apparentSize);
+
+        std::vector<std::string> directories = directoryPaths(tree);
         std::vector<std::pair<std::string, uintmax_t>> files;
+        files.reserve(list.entries().size());
+        for (const auto& entry : list.entries())
+        {
+            files.emplace_back(directories[entry.directory] + "/" + std::string(list.name(entry)),
+                               m_options.apparentSize ? entry.size : entry.allocated);
+        }
 
-        // Recursively iterate through the directory and collect file data
-        try
+        // Display files in pages
+        displayFilesPaginated(files);
+    }
+
+    // Scans the given directory in one pass, aggregating sizes per directory, and lets the user
+    // drill down from the root into the largest subtrees. If 'snapshotPath' is set the tree is
+    // also saved there, for comparison with a later scan
+    void analyseTree(const std::string& path, const std::string& snapshotPath = "", bool browse = true)
+    {
+        DirectoryTree tree;
+        if (!buildTree(path, tree))
+        {
+            return;
+        }
+        if (!snapshotPath.empty())
         {
-            for (const auto& entry : fs::recursive_directory_iterator(path))
+            if (!DiskSnapshot::save(tree, snapshotPath))
             {
-                if (fs::is_regular_file(entry))
-                {
-                    files.emplace_back(entry.path().string(), fs::file_size(entry));
-                }
+                std::cerr << "Error writing snapshot: " << snapshotPath << std::endl;
+            }
+            else
+            {
+                std::cout << "Saved " << tree.size() << " directories to " << snapshotPath << std::endl;
+            }
+        }
+        if (browse)
+        {
+            browseTree(tree);
+        }
+    }
+
+    // Compares two snapshots of the same directory and lists the subtrees that grew the most.
+    // Returns false if either snapshot cannot be opened or is not a valid snapshot
+    static bool compareSnapshots(const std::string& olderPath, const std::string& newerPath, size_t limit)
+    {
+        DiskSnapshot older(olderPath);
+        DiskSnapshot newer(newerPath);
+        for (const auto* snapshot : { &older, &newer })
+        {
+            if (!snapshot->isOpen())
+            {
+                std::cerr << "Error reading snapshot (missing, unreadable or corrupt): "
+                          << (snapshot == &older ? olderPath : newerPath) << std::endl;
+                return false;
             }
         }
-        catch (const fs::filesystem_error& e)
+
+        int64_t total = static_cast<int64_t>(newer.node(0).allocated) - static_cast<int64_t>(older.node(0).allocated);
+        std::cout << "Total growth: " << total / 1024 << " KB (" << older.node(0).allocated / 1024 << " KB -> "
+                  << newer.node(0).allocated / 1024 << " KB)" << std::endl;
+
+        std::vector<SnapshotDiff::Growth> hotspots = SnapshotDiff::hotspots(older, newer, limit);
+        if (hotspots.empty())
+        {
+            std::cout << "No directory grew." << std::endl;
+            return true;
+        }
+
+        constexpr int lineLength = 81;
+        std::cout << std::string(lineLength, '-') << std::endl;
+        std::cout << "| " << std::setw(50) << std::left << "Directory" << " | " << std::setw(11) << "Growth (KB)"
+                  << " | " << std::setw(10) << "Now (KB)" << " |" << std::endl;
+        std::cout << std::string(lineLength, '-') << std::endl;
+        for (const auto& growth : hotspots)
+        {
+            std::cout << "| " << std::setw(50) << std::left << newer.path(growth.node).substr(0, 50)
+                      << " | " << std::setw(11) << growth.delta / 1024
+                      << " | " << std::setw(10) << newer.node(growth.node).allocated / 1024 << " |" << std::endl;
+        }
+        std::cout << std::string(lineLength, '-') << std::endl;
+        return true;
+    }
+
+    // Scans the given directory keeping only the 'limit' largest files, then displays them in pages.
+    // Memory and time stay flat regardless of how many files the volume holds
+    void analyseTopFiles(const std::string& path, size_t limit)
+    {
+        DirectoryTree tree;
+        TopFiles top(limit);
+        if (!buildTree(path, tree, &top))
         {
-            std::cerr << "Error accessing file: " << e.what() << std::endl;
             return;
         }
 
-        // Check if any files were found
+        std::vector<std::pair<std::string, uintmax_t>> files;
+        for (const auto& entry : top.sorted())
+        {
+            files.emplace_back((fs::path(tree.path(entry.directory)) / entry.name).string(), entry.size);
+        }
         if (files.empty())
         {
             std::cout << "No files found in the directory." << std::endl;
             return;
         }
+        displayFilesPaginated(files);
+    }
 
-        // Sort files in descending order by size
-        std::sort(files.begin(), files.end(), [](const auto& a, const auto& b)
+    // Scans the given directory once and prints what kind of files fill it: a log2 size histogram,
+    // the extensions using the most space and how old the data is
+    void analyseBreakdown(const std::string& path, size_t extensionRows = 20)
+    {
+        DirectoryTree tree;
+        FileBreakdown breakdown;
+        if (!buildTree(path, tree, nullptr, nullptr, &breakdown))
         {
-            return a.second > b.second;
-        });
+            return;
+        }
+        uintmax_t totalBytes = m_options.apparentSize ? tree.node(0).size : tree.node(0).allocated;
+        std::cout << tree.path(0) << "  (" << tree.node(0).fileCount << " files, " << totalBytes / 1024 << " KB)" << std::endl;
 
-        // Display files in pages
-        displayFilesPaginated(files);
+        const auto& sizes = breakdown.sizes();
+        std::vector<std::pair<std::string, FileBreakdown::Bucket>> rows;
+        for (size_t i = 0; i < sizes.size(); ++i)
+        {
+            if (sizes[i].count > 0)
+            {
+                std::string label = i == 0 ? "0 B" : formatBytes(uintmax_t(1) << (i - 1)) + " - " +
+                                    (i == 64 ? std::string("16 EB") : formatBytes(uintmax_t(1) << i));
+                rows.emplace_back(label, sizes[i]);
+            }
+        }
+        printBuckets("File size", rows, totalBytes);
+
+        rows.clear();
+        for (const auto& extension : breakdown.extensions())
+        {
+            if (rows.size() == extensionRows)
+            {
+                break;
+            }
+            rows.emplace_back(extension.name[0] == '\0' ? "(none)" : "." + std::string(extension.name), extension.total);
+        }
+        printBuckets("Extension", rows, totalBytes);
+
+        static const char* ageLabels[FileBreakdown::AgeBuckets] = { "< 1 day", "1 day - 1 week", "1 week - 1 month",
+                                                                    "1 - 3 months", "3 - 12 months", "1 - 3 years",
+                                                                    "3 - 10 years", "> 10 years" };
+        rows.clear();
+        for (size_t i = 0; i < FileBreakdown::AgeBuckets; ++i)
+        {
+            rows.emplace_back(ageLabels[i], breakdown.ages()[i]);
+        }
+        printBuckets("Last modified", rows, totalBytes);
+    }
+
+    // Scans the given directory and streams every file that passed the size and depth filters to
+    // stdout, largest first, without any prompts. 'limit' caps the number of rows (0 = all)
+    bool writeReport(const std::string& path, ReportFormat format, size_t limit = 0)
+    {
+        DirectoryTree tree;
+        FileList files;
+        if (!buildTree(path, tree, nullptr, &files))
+        {
+            return false;
+        }
+        files.sort(m_options.apparentSize);
+        std::vector<std::string> directories = directoryPaths(tree);
+
+        ReportWriter writer(format);
+        writer.useApparentSize(m_options.apparentSize);
+        for (const auto& entry : files.entries())
+        {
+            if (limit > 0 && writer.rows() == limit)
+            {
+                break;
+            }
+            writer.write(directories[entry.directory], files.name(entry), entry.size, entry.allocated);
+        }
+        if (!writer.finish())
+        {
+            std::cerr << "Error writing report: " << std::strerror(errno) << std::endl;
+            return false;
+        }
+        return true;
     }
 
 private:
+    ScanOptions m_options;
+
+    // Builds the directory tree of 'path' with the parallel scanner, optionally collecting the largest
+    // files, every file that passes the filters, or the file breakdown
+    bool buildTree(const std::string& path, DirectoryTree& tree, TopFiles* top = nullptr, FileList* files = nullptr,
+                   FileBreakdown* breakdown = nullptr)
+    {
+        ParallelScanner scanner(m_options);
+        if (!scanner.scan(path, tree, top, files, breakdown))
+        {
+            std::cerr << "Error accessing directory: " << path << ": " << std::strerror(errno) << std::endl;
+            return false;
+        }
+
+        const ScanStatistics& stats = scanner.statistics();
+        if (stats.duplicateHardlinks > 0 || stats.skippedMounts > 0)
+        {
+            std::cerr << "Counted " << stats.duplicateHardlinks << " duplicate hardlinks once and skipped "
+                      << stats.skippedMounts << " mount points" << std::endl;
+        }
+        if (stats.unreadableDirectories > 0)
+        {
+            std::cerr << "Could not read " << stats.unreadableDirectories << " directories; their contents are missing from the totals:" << std::endl;
+            for (const auto& directory : stats.unreadable)
+            {
+                std::cerr << "  " << directory.path << ": " << std::strerror(directory.error) << std::endl;
+            }
+            if (stats.unreadableDirectories > stats.unreadable.size())
+            {
+                std::cerr << "  ..." << std::endl;
+            }
+        }
+        return true;
+    }
+
+    // Builds every directory's path once, in id order, since a parent always precedes its children.
+    // Trailing slashes are dropped from the root so that "/" yields "/etc" rather than "//etc"
+    static std::vector<std::string> directoryPaths(const DirectoryTree& tree)
+    {
+        std::vector<std::string> directories(tree.size());
+        directories[0] = tree.node(0).name;
+        while (!directories[0].empty() && directories[0].back() == '/')
+        {
+            directories[0].pop_back();
+        }
+        for (uint32_t id = 1; id < tree.size(); ++id)
+        {
+            const DirectoryNode& node = tree.node(id);
+            directories[id] = directories[node.parent] + "/" + node.name;
+        }
+        return directories;
+    }
+
+    // Formats a power-of-two byte count with a binary unit, e.g. 4096 -> "4 KB"
+    static std::string formatBytes(uintmax_t bytes)
+    {
+        static const char* units[] = { "B", "KB", "MB", "GB", "TB", "PB", "EB" };
+        size_t unit = 0;
+        while (bytes >= 1024 && bytes % 1024 == 0 && unit < 6)
+        {
+            bytes /= 1024;
+            ++unit;
+        }
+        return std::to_string(bytes) + " " + units[unit];
+    }
+
+    // Prints one breakdown table with the share of the total bytes held by each row
+    static void printBuckets(const std::string& title, const std::vector<std::pair<std::string, FileBreakdown::Bucket>>& rows,
+                             uintmax_t totalBytes)
+    {
+        constexpr int lineLength = 72;
+        std::cout << "\n" << std::string(lineLength, '-') << std::endl;
+        std::cout << "| " << std::setw(24) << std::left << title << " | " << std::setw(12) << "Files"
+                  << " | " << std::setw(14) << "Size (KB)" << " | " << std::setw(8) << "Share" << " |" << std::endl;
+        std::cout << std::string(lineLength, '-') << std::endl;
+        for (const auto& row : rows)
+        {
+            double share = totalBytes > 0 ? 100.0 * static_cast<double>(row.second.bytes) / static_cast<double>(totalBytes) : 0.0;
+            std::cout << "| " << std::setw(24) << std::left << row.first.substr(0, 24) << " | " << std::setw(12) << row.second.count
+                      << " | " << std::setw(14) << row.second.bytes / 1024 << " | " << std::setw(7) << std::right
+                      << std::fixed << std::setprecision(1) << share << "%" << std::left << " |" << std::endl;
+        }
+        std::cout << std::string(lineLength, '-') << std::endl;
+    }
+
+    // Shows the largest subtrees of the current directory. The user enters a row number to descend,
+    // 'u' to go up one level, or 'q' to quit
+    void browseTree(const DirectoryTree& tree, size_t rowsPerPage = 10)
+    {
+        uint32_t current = 0;
+        while (true)
+        {
+            const DirectoryNode& node = tree.node(current);
+            std::vector<uint32_t> children = tree.sortedChildren(current, m_options.apparentSize);
+
+            constexpr int lineLength = 88;
+            std::cout << "\n" << tree.path(current) << "  (" << node.size / 1024 << " KB, "
+                      << node.allocated / 1024 << " KB allocated, " << node.fileCount << " files)" << std::endl;
+            std::cout << std::string(lineLength, '-') << std::endl;
+            std::cout << "| " << std::setw(4) << std::right << "#" << " | " << std::setw(40) << std::left << "Directory"
+                      << " | " << std::setw(10) << "Size (KB)" << " | " << std::setw(10) << "Alloc (KB)"
+                      << " | " << std::setw(8) << "Files" << " |" << std::endl;
+            std::cout << std::string(lineLength, '-') << std::endl;
+
+            size_t shown = std::min(rowsPerPage, children.size());
+            for (size_t i = 0; i < shown; ++i)
+            {
+                const DirectoryNode& child = tree.node(children[i]);
+                std::cout << "| " << std::setw(4) << std::right << i + 1 << " | " << std::setw(40) << std::left
+                          << child.name.substr(0, 40) << " | " << std::setw(10) << child.size / 1024
+                          << " | " << std::setw(10) << child.allocated / 1024
+                          << " | " << std::setw(8) << child.fileCount << " |" << std::endl;
+            }
+            std::cout << std::string(lineLength, '-') << std::endl;
+
+            std::cout << "Enter a number to open a directory, 'u' to go up, or 'q' to quit: ";
+            std::string input;
+            if (!std::getline(std::cin, input) || input == "q")
+            {
+                break;
+            }
+            if (input == "u")
+            {
+                current = node.parent;
+                continue;
+            }
+            try
+            {
+                size_t choice = std::stoul(input);
+                if (choice >= 1 && choice <= shown)
+                {
+                    current = children[choice - 1];
+                }
+            }
+            catch (const std::exception&)
+            {
+                std::cout << "Invalid choice." << std::endl;
+            }
+        }
+    }
+
     // Displays file information in a paginated table format
     // Each page shows 'pageSize' files. User can press Enter to continue or type 'q' to quit
     void displayFilesPaginated(const std::vector<std::pair<std::string, uintmax_t>>& files, size_t pageSize = 10)
@@ -99,14 +417,194 @@ private:
     }
 };
 
-int main()
+// Parses the decimal digits at the start of 'text' into a value no larger than 'max' and sets 'end'
+// past them. Input that does not start with a digit (signs, spaces, nothing) and overflow are rejected
+bool parseNumber(const std::string& text, uintmax_t max, uintmax_t& value, size_t& end)
+{
+    if (text.empty() || !std::isdigit(static_cast<unsigned char>(text[0])))
+    {
+        return false;
+    }
+    value = 0;
+    for (end = 0; end < text.size() && std::isdigit(static_cast<unsigned char>(text[end])); ++end)
+    {
+        uintmax_t digit = static_cast<uintmax_t>(text[end] - '0');
+        if (value > (max - digit) / 10)
+        {
+            return false;
+        }
+        value = value * 10 + digit;
+    }
+    return true;
+}
+
+// Parses a whole count such as a thread or row limit
+bool parseCount(const std::string& text, uintmax_t max, uintmax_t& value)
+{
+    size_t end = 0;
+    return parseNumber(text, max, value, end) && end == text.size();
+}
+
+// Parses a byte count with an optional K, M, G or T suffix (powers of 1024)
+bool parseSize(const std::string& text, uintmax_t& value)
+{
+    size_t end = 0;
+    if (!parseNumber(text, UINTMAX_MAX, value, end))
+    {
+        return false;
+    }
+    if (end == text.size())
+    {
+        return true;
+    }
+    const std::string units = "KMGT";
+    size_t exponent = units.find(static_cast<char>(std::toupper(static_cast<unsigned char>(text[end]))));
+    unsigned int shift = static_cast<unsigned int>(10 * (exponent + 1));
+    if (exponent == std::string::npos || end + 1 != text.size() || value > (UINTMAX_MAX >> shift))
+    {
+        return false;
+    }
+    value <<= shift;
+    return true;
+}
+
+int main(int argc, char* argv[])
 {
+    bool treeMode = false;
+    bool breakdownMode = false;
+    size_t topCount = 0;
+    ScanOptions options;
     std::string path;
-    std::cout << "Enter directory to analyse: ";
-    std::getline(std::cin, path);
+    std::string snapshotPath;
+    std::string diffOlder;
+    std::string diffNewer;
+    std::string reportFormat;
 
-    DiskUsageAnalyser analyser;
-    analyser.analyseDirectory(path);
+    // Reads the numeric value of option 'arg'; prints an error and returns false if it is invalid
+    auto numericValue = [](const std::string& arg, const std::string& text, uintmax_t max, uintmax_t& value)
+    {
+        bool ok = arg == "--min-size" ? parseSize(text, value) : parseCount(text, max, value);
+        if (!ok)
+        {
+            std::cerr << "Invalid value for " << arg << ": '" << text << "'" << std::endl;
+        }
+        return ok;
+    };
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        uintmax_t value = 0;
+        if (arg == "--tree")
+        {
+            treeMode = true;
+        }
+        else if (arg == "--threads" && i + 1 < argc)
+        {
+            if (!numericValue(arg, argv[++i], 1024, value))
+                return 1;
+            options.threads = static_cast<unsigned int>(value);
+        }
+        else if (arg == "--breakdown")
+        {
+            breakdownMode = true;
+        }
+        else if (arg == "--apparent-size")
+        {
+            options.apparentSize = true;
+        }
+        else if (arg == "--one-file-system" || arg == "-x")
+        {
+            options.oneFileSystem = true;
+        }
+        else if (arg == "--top" && i + 1 < argc)
+        {
+            if (!numericValue(arg, argv[++i], SIZE_MAX, value))
+                return 1;
+            topCount = static_cast<size_t>(value);
+        }
+        else if (arg == "--save" && i + 1 < argc)
+        {
+            snapshotPath = argv[++i];
+        }
+        else if (arg == "--diff" && i + 2 < argc)
+        {
+            diffOlder = argv[++i];
+            diffNewer = argv[++i];
+        }
+        else if (arg == "--report" && i + 1 < argc)
+        {
+            reportFormat = argv[++i];
+        }
+        else if (arg == "--min-size" && i + 1 < argc)
+        {
+            if (!numericValue(arg, argv[++i], UINTMAX_MAX, value))
+                return 1;
+            options.minFileSize = value;
+        }
+        else if (arg == "--max-depth" && i + 1 < argc)
+        {
+            if (!numericValue(arg, argv[++i], UINT32_MAX, value))
+                return 1;
+            options.maxDepth = static_cast<uint32_t>(value);
+        }
+        else
+        {
+            path = arg;
+        }
+    }
+
+    if (!diffOlder.empty())
+    {
+        return DiskUsageAnalyser::compareSnapshots(diffOlder, diffNewer, topCount > 0 ? topCount : 20) ? 0 : 1;
+    }
+
+    if (!reportFormat.empty())
+    {
+        // Report mode never prompts, so it can run from scripts and schedulers
+        ReportFormat format;
+        if (reportFormat == "csv")
+            format = ReportFormat::Csv;
+        else if (reportFormat == "json")
+            format = ReportFormat::Json;
+        else if (reportFormat == "nul")
+            format = ReportFormat::Nul;
+        else
+        {
+            std::cerr << "Unknown report format: " << reportFormat << " (expected csv, json or nul)" << std::endl;
+            return 1;
+        }
+        if (path.empty())
+        {
+            std::cerr << "A directory is required with --report" << std::endl;
+            return 1;
+        }
+        return DiskUsageAnalyser(options).writeReport(path, format, topCount) ? 0 : 1;
+    }
+
+    if (path.empty())
+    {
+        std::cout << "Enter directory to analyse: ";
+        std::getline(std::cin, path);
+    }
+
+    DiskUsageAnalyser analyser(options);
+    if (breakdownMode)
+    {
+        analyser.analyseBreakdown(path, topCount > 0 ? topCount : 20);
+    }
+    else if (treeMode || !snapshotPath.empty())
+    {
+        analyser.analyseTree(path, snapshotPath, treeMode);
+    }
+    else if (topCount > 0)
+    {
+        analyser.analyseTopFiles(path, topCount);
+    }
+    else
+    {
+        analyser.analyseDirectory(path);
+    }
 
     return 0;
 }
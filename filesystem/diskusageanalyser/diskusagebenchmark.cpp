@@ -0,0 +1,105 @@
+#include <iostream>
+#include <chrono>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include "diskusagescanner.h"
+
+// Creates a synthetic tree of 'fileCount' sparse files under 'root', laid out as root/dNNN/dMMM with
+// 1000 files per leaf directory. Files are sized with ftruncate, so the tree occupies almost no space.
+// Returns false if the tree already exists, in which case it is reused as is
+bool createSyntheticTree(const fs::path& root, size_t fileCount)
+{
+    fs::path marker = root / ".complete";
+    if (fs::exists(marker))
+    {
+        return false;
+    }
+
+    constexpr size_t filesPerDirectory = 1000;
+    constexpr size_t directoriesPerGroup = 100;
+    uint64_t seed = 88172645463325252ull;
+
+    for (size_t created = 0; created < fileCount;)
+    {
+        size_t leaf = created / filesPerDirectory;
+        fs::path directory = root / ("d" + std::to_string(leaf / directoriesPerGroup))
+                                  / ("d" + std::to_string(leaf % directoriesPerGroup));
+        fs::create_directories(directory);
+
+        for (size_t i = 0; i < filesPerDirectory && created < fileCount; ++i, ++created)
+        {
+            std::string file = (directory / ("f" + std::to_string(i))).string();
+            int fd = ::open(file.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+            if (fd < 0)
+            {
+                std::cerr << "Error creating " << file << "\n";
+                return false;
+            }
+            // xorshift64 gives a spread of sizes up to 16 MB without touching the disk
+            seed ^= seed << 13;
+            seed ^= seed >> 7;
+            seed ^= seed << 17;
+            if (::ftruncate(fd, static_cast<off_t>(seed % (16u << 20))) != 0)
+            {
+                std::cerr << "Error sizing " << file << "\n";
+            }
+            ::close(fd);
+        }
+    }
+
+    int fd = ::open(marker.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+    if (fd >= 0)
+    {
+        ::close(fd);
+    }
+    return true;
+}
+
+// Scans the same tree with 1 to 32 threads and reports throughput and speedup over one thread.
+// The first pass warms the dentry/inode caches, so the numbers measure CPU and syscall scaling;
+// drop the caches between runs (as root) to measure cold I/O instead
+int main(int argc, char* argv[])
+{
+    fs::path root = argc > 1 ? argv[1] : "du_benchmark_tree";
+    size_t fileCount = argc > 2 ? std::stoul(argv[2]) : 5000000;
+
+    auto start = std::chrono::steady_clock::now();
+    if (createSyntheticTree(root, fileCount))
+    {
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "Created " << fileCount << " files under " << root << " in " << seconds << " s\n";
+    }
+
+    {
+        DirectoryTree warmup;
+        ParallelScanner(ScanOptions{ 0 }).scan(root.string(), warmup);
+    }
+
+    double baseline = 0.0;
+    std::cout << std::setw(8) << "Threads" << std::setw(12) << "Seconds" << std::setw(14) << "Files/s"
+              << std::setw(10) << "Speedup" << "\n";
+    for (unsigned int threads = 1; threads <= 32; threads *= 2)
+    {
+        DirectoryTree tree;
+        ParallelScanner scanner(ScanOptions{ threads });
+        start = std::chrono::steady_clock::now();
+        if (!scanner.scan(root.string(), tree))
+        {
+            std::cerr << "Error accessing directory: " << root << "\n";
+            return 1;
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (threads == 1)
+        {
+            baseline = seconds;
+        }
+
+        uintmax_t files = tree.node(0).fileCount;
+        std::cout << std::setw(8) << threads << std::setw(12) << std::fixed << std::setprecision(3) << seconds
+                  << std::setw(14) << static_cast<uintmax_t>(files / seconds)
+                  << std::setw(10) << std::setprecision(2) << baseline / seconds << "\n";
+    }
+
+    return 0;
+}
@@ -0,0 +1,902 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+extern "C"
+{
+    #include <dirent.h>
+    #include <fcntl.h>
+    #include <sys/resource.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+}
+
+namespace fs = std::filesystem;
+
+// DirectoryNode stores the totals of one directory. Only the entry name is kept, not the full
+// path, and files are never stored individually, so memory grows with the number of directories
+struct DirectoryNode
+{
+    std::string name;           // Entry name (the scanned path for the root)
+    uint32_t parent;            // Index of the parent node (the root is its own parent)
+    uintmax_t size{ 0 };        // Cumulative apparent size in bytes
+    uintmax_t allocated{ 0 };   // Cumulative allocated size in bytes (st_blocks * 512)
+    uintmax_t fileCount{ 0 };   // Cumulative number of regular files
+};
+
+// DirectoryTree holds every scanned directory in a flat vector. A child is always created after its
+// parent, so totals can be rolled up in a single reverse pass without recursion
+class DirectoryTree
+{
+public:
+    uint32_t addNode(const std::string& name, uint32_t parent)
+    {
+        uint32_t id = static_cast<uint32_t>(m_nodes.size());
+        m_nodes.push_back({ name, parent });
+        return id;
+    }
+
+    // Replaces the nodes with ones built elsewhere, indexed by id
+    void setNodes(std::vector<DirectoryNode> nodes)
+    {
+        m_nodes = std::move(nodes);
+    }
+
+    DirectoryNode& node(uint32_t id) { return m_nodes[id]; }
+    const DirectoryNode& node(uint32_t id) const { return m_nodes[id]; }
+    size_t size() const { return m_nodes.size(); }
+
+    // Adds every directory's totals into its ancestors and builds the child lists
+    void finalise()
+    {
+        for (size_t id = m_nodes.size(); id-- > 1;)
+        {
+            DirectoryNode& parent = m_nodes[m_nodes[id].parent];
+            parent.size += m_nodes[id].size;
+            parent.allocated += m_nodes[id].allocated;
+            parent.fileCount += m_nodes[id].fileCount;
+        }
+
+        // Child lists are stored as one contiguous array indexed by per-node offsets
+        m_childOffsets.assign(m_nodes.size() + 1, 0);
+        for (size_t id = 1; id < m_nodes.size(); ++id)
+        {
+            ++m_childOffsets[m_nodes[id].parent + 1];
+        }
+        for (size_t i = 1; i < m_childOffsets.size(); ++i)
+        {
+            m_childOffsets[i] += m_childOffsets[i - 1];
+        }
+        m_children.resize(m_nodes.empty() ? 0 : m_nodes.size() - 1);
+        std::vector<uint32_t> fill(m_childOffsets.begin(), m_childOffsets.end() - 1);
+        for (size_t id = 1; id < m_nodes.size(); ++id)
+        {
+            m_children[fill[m_nodes[id].parent]++] = static_cast<uint32_t>(id);
+        }
+    }
+
+    // Returns the unsorted children of a node as a contiguous range
+    std::pair<const uint32_t*, const uint32_t*> children(uint32_t id) const
+    {
+        const uint32_t* base = m_children.data();
+        return { base + m_childOffsets[id], base + m_childOffsets[id + 1] };
+    }
+
+    // Returns the children of a node, largest subtree first (by allocated or apparent size)
+    std::vector<uint32_t> sortedChildren(uint32_t id, bool byApparentSize = false) const
+    {
+        std::vector<uint32_t> children(m_children.begin() + m_childOffsets[id], m_children.begin() + m_childOffsets[id + 1]);
+        std::sort(children.begin(), children.end(), [this, byApparentSize](uint32_t a, uint32_t b)
+        {
+            return byApparentSize ? m_nodes[a].size > m_nodes[b].size : m_nodes[a].allocated > m_nodes[b].allocated;
+        });
+        return children;
+    }
+
+    // Rebuilds the full path of a node from the names along its parent chain
+    std::string path(uint32_t id) const
+    {
+        fs::path result;
+        std::vector<uint32_t> chain;
+        for (; id != 0; id = m_nodes[id].parent)
+        {
+            chain.push_back(id);
+        }
+        result = m_nodes.empty() ? "" : m_nodes[0].name;
+        for (auto it = chain.rbegin(); it != chain.rend(); ++it)
+        {
+            result /= m_nodes[*it].name;
+        }
+        return result.string();
+    }
+
+private:
+    std::vector<DirectoryNode> m_nodes;
+    std::vector<uint32_t> m_childOffsets;
+    std::vector<uint32_t> m_children;
+};
+
+// TopFiles keeps the K largest files seen so far in a min-heap, so the smallest survivor is evicted
+// first. A file is identified by its directory node and entry name; the full path is only built
+// for the survivors once the scan is over
+class TopFiles
+{
+public:
+    struct Entry
+    {
+        uintmax_t size;
+        uint32_t directory;
+        std::string name;
+    };
+
+    explicit TopFiles(size_t limit) : m_limit(limit)
+    {
+        m_heap.reserve(limit);
+    }
+
+    size_t limit() const
+    {
+        return m_limit;
+    }
+
+    // Cheap check used before copying the entry name
+    bool accepts(uintmax_t size) const
+    {
+        return m_limit > 0 && (m_heap.size() < m_limit || size > m_heap.front().size);
+    }
+
+    void add(uintmax_t size, uint32_t directory, const char* name)
+    {
+        if (!accepts(size))
+        {
+            return;
+        }
+        if (m_heap.size() == m_limit)
+        {
+            std::pop_heap(m_heap.begin(), m_heap.end(), greater);
+            m_heap.pop_back();
+        }
+        m_heap.push_back({ size, directory, name });
+        std::push_heap(m_heap.begin(), m_heap.end(), greater);
+    }
+
+    // Folds another heap (e.g. a worker's) into this one
+    void merge(const TopFiles& other)
+    {
+        for (const auto& entry : other.m_heap)
+        {
+            if (accepts(entry.size))
+            {
+                add(entry.size, entry.directory, entry.name.c_str());
+            }
+        }
+    }
+
+    // Returns the survivors, largest first
+    std::vector<Entry> sorted() const
+    {
+        std::vector<Entry> entries = m_heap;
+        std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.size > b.size; });
+        return entries;
+    }
+
+private:
+    static bool greater(const Entry& a, const Entry& b)
+    {
+        return a.size > b.size;
+    }
+
+    size_t m_limit;
+    std::vector<Entry> m_heap;
+};
+
+// FileList collects every file that passed the scan filters, for reports that need all of them.
+// Names are packed into one string arena so that millions of entries cost no per-file allocation
+class FileList
+{
+public:
+    struct Entry
+    {
+        uintmax_t size;             // Apparent size in bytes
+        uintmax_t allocated;        // Allocated size in bytes
+        uint32_t directory;         // Node id of the containing directory
+        uint32_t nameLength;
+        size_t nameOffset;          // Offset of the name in the arena
+    };
+
+    void add(uintmax_t size, uintmax_t allocated, uint32_t directory, const char* name)
+    {
+        size_t length = std::strlen(name);
+        m_entries.push_back({ size, allocated, directory, static_cast<uint32_t>(length), m_names.size() });
+        m_names.append(name, length);
+    }
+
+    // Appends another list (e.g. a worker's), rebasing its name offsets
+    void merge(const FileList& other)
+    {
+        size_t base = m_names.size();
+        m_names += other.m_names;
+        m_entries.reserve(m_entries.size() + other.m_entries.size());
+        for (Entry entry : other.m_entries)
+        {
+            entry.nameOffset += base;
+            m_entries.push_back(entry);
+        }
+    }
+
+    // Orders the entries largest first, by allocated or apparent size
+    void sort(bool byApparentSize = false)
+    {
+        std::sort(m_entries.begin(), m_entries.end(), [byApparentSize](const Entry& a, const Entry& b)
+        {
+            return byApparentSize ? a.size > b.size : a.allocated > b.allocated;
+        });
+    }
+
+    std::string_view name(const Entry& entry) const
+    {
+        return std::string_view(m_names.data() + entry.nameOffset, entry.nameLength);
+    }
+
+    const std::vector<Entry>& entries() const { return m_entries; }
+    bool empty() const { return m_entries.empty(); }
+
+private:
+    std::vector<Entry> m_entries;
+    std::string m_names;
+};
+
+// FileBreakdown classifies files three ways in a single pass: a log2 size histogram, totals per
+// extension and age buckets by modification time. All tables have a fixed size, so every worker can
+// keep its own copy without allocating per file, and the copies are summed once the scan ends
+class FileBreakdown
+{
+public:
+    struct Bucket
+    {
+        uintmax_t count{ 0 };
+        uintmax_t bytes{ 0 };
+    };
+
+    struct Extension
+    {
+        char name[16];              // Lower-case extension without the dot, NUL-terminated
+        Bucket total;
+    };
+
+    // Histogram bucket i holds sizes in [2^(i-1), 2^i); bucket 0 holds empty files
+    static constexpr size_t SizeBuckets = 65;
+    static constexpr size_t AgeBuckets = 8;
+    static constexpr size_t ExtensionSlots = 1024;
+
+    // Upper bounds of the age buckets in seconds; the last bucket is everything older
+    static constexpr int64_t AgeLimits[AgeBuckets - 1] = { 86400, 7 * 86400, 30 * 86400, 91 * 86400,
+                                                           365 * 86400, 3 * 365 * 86400, 10 * 365 * 86400 };
+
+    // 'now' anchors the age buckets; workers of one scan share it so their buckets line up
+    explicit FileBreakdown(int64_t now = static_cast<int64_t>(std::time(nullptr)))
+        : m_now(now), m_extensions(ExtensionSlots)
+    {
+    }
+
+    void add(const char* name, uintmax_t bytes, int64_t mtime)
+    {
+        Bucket& size = m_sizes[bytes == 0 ? 0 : 64 - __builtin_clzll(bytes)];
+        ++size.count;
+        size.bytes += bytes;
+
+        int64_t age = m_now - mtime;
+        size_t bucket = 0;
+        while (bucket < AgeBuckets - 1 && age >= AgeLimits[bucket])
+        {
+            ++bucket;
+        }
+        ++m_ages[bucket].count;
+        m_ages[bucket].bytes += bytes;
+
+        Bucket& extension = extensionBucket(name);
+        ++extension.count;
+        extension.bytes += bytes;
+    }
+
+    // Adds another breakdown (e.g. a worker's) into this one
+    void merge(const FileBreakdown& other)
+    {
+        for (size_t i = 0; i < SizeBuckets; ++i)
+        {
+            m_sizes[i].count += other.m_sizes[i].count;
+            m_sizes[i].bytes += other.m_sizes[i].bytes;
+        }
+        for (size_t i = 0; i < AgeBuckets; ++i)
+        {
+            m_ages[i].count += other.m_ages[i].count;
+            m_ages[i].bytes += other.m_ages[i].bytes;
+        }
+        for (const auto& slot : other.m_extensions)
+        {
+            if (slot.total.count > 0)
+            {
+                Bucket& total = lookup(slot.name);
+                total.count += slot.total.count;
+                total.bytes += slot.total.bytes;
+            }
+        }
+        m_other.count += other.m_other.count;
+        m_other.bytes += other.m_other.bytes;
+    }
+
+    const std::array<Bucket, SizeBuckets>& sizes() const { return m_sizes; }
+    const std::array<Bucket, AgeBuckets>& ages() const { return m_ages; }
+
+    // Returns the used extension slots, most bytes first. Files without an extension are listed under
+    // an empty name; extensions that are too long or did not fit in the table come last as "(other)"
+    std::vector<Extension> extensions() const
+    {
+        std::vector<Extension> result;
+        for (const auto& slot : m_extensions)
+        {
+            if (slot.total.count > 0)
+            {
+                result.push_back(slot);
+            }
+        }
+        std::sort(result.begin(), result.end(), [](const Extension& a, const Extension& b)
+        {
+            return a.total.bytes > b.total.bytes;
+        });
+        if (m_other.count > 0)
+        {
+            result.push_back({ "(other)", m_other });
+        }
+        return result;
+    }
+
+private:
+    int64_t m_now;
+    std::array<Bucket, SizeBuckets> m_sizes{};
+    std::array<Bucket, AgeBuckets> m_ages{};
+    std::vector<Extension> m_extensions;        // Open-addressing table, never resized
+    Bucket m_other;
+    size_t m_usedSlots{ 0 };
+
+    // Finds the bucket of a file's extension; a leading dot (hidden file) does not start an extension
+    Bucket& extensionBucket(const char* name)
+    {
+        const char* dot = std::strrchr(name, '.');
+        if (!dot || dot == name)
+        {
+            return lookup("");
+        }
+        char key[sizeof(Extension::name)];
+        size_t length = 0;
+        for (const char* c = dot + 1; *c; ++c)
+        {
+            if (length == sizeof(key) - 1)
+            {
+                return m_other;
+            }
+            key[length++] = static_cast<char>(std::tolower(static_cast<unsigned char>(*c)));
+        }
+        key[length] = '\0';
+        return lookup(key);
+    }
+
+    // Linear probing over the fixed table. A slot is taken once its count is non-zero, which every
+    // caller ensures right after the lookup. The table is kept at most 3/4 full; new extensions
+    // beyond that are counted as "(other)"
+    Bucket& lookup(const char* key)
+    {
+        uint64_t hash = 14695981039346656037ull;
+        for (const char* c = key; *c; ++c)
+        {
+            hash = (hash ^ static_cast<unsigned char>(*c)) * 1099511628211ull;
+        }
+        for (size_t i = hash & (ExtensionSlots - 1);; i = (i + 1) & (ExtensionSlots - 1))
+        {
+            Extension& slot = m_extensions[i];
+            if (slot.total.count > 0)
+            {
+                if (std::strcmp(slot.name, key) == 0)
+                {
+                    return slot.total;
+                }
+                continue;
+            }
+            if (m_usedSlots * 4 >= ExtensionSlots * 3)
+            {
+                return m_other;
+            }
+            std::strcpy(slot.name, key);
+            ++m_usedSlots;
+            return slot.total;
+        }
+    }
+};
+
+// InodeSet records (device, inode) pairs of multiply-linked files so each is counted once. It is an
+// open-addressing hash table of 16-byte slots, split into independently locked shards so that
+// workers rarely contend. Only files with st_nlink > 1 are ever inserted
+class InodeSet
+{
+public:
+    // Returns true if the pair was not present yet (and has now been recorded)
+    bool insert(uint64_t device, uint64_t inode)
+    {
+        uint64_t hash = mix(inode ^ (device * 0x9E3779B97F4A7C15ull));
+        Shard& shard = m_shards[hash >> (64 - ShardBits)];
+
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        if ((shard.used + 1) * 10 > shard.slots.size() * 7)
+        {
+            grow(shard);
+        }
+        if (!place(shard.slots, { device, inode }, hash))
+        {
+            return false;
+        }
+        ++shard.used;
+        return true;
+    }
+
+private:
+    static constexpr unsigned int ShardBits = 6;
+
+    // Inode 0 is never assigned to a file, so a zero inode marks an empty slot
+    struct Key
+    {
+        uint64_t device;
+        uint64_t inode;
+    };
+
+    struct Shard
+    {
+        std::mutex mutex;
+        std::vector<Key> slots;
+        size_t used{ 0 };
+    };
+
+    std::array<Shard, 1u << ShardBits> m_shards;
+
+    static uint64_t mix(uint64_t x)
+    {
+        x ^= x >> 33;
+        x *= 0xFF51AFD7ED558CCDull;
+        x ^= x >> 33;
+        x *= 0xC4CEB9FE1A85EC53ull;
+        x ^= x >> 33;
+        return x;
+    }
+
+    // Linear probing; returns false if the key is already present
+    static bool place(std::vector<Key>& slots, const Key& key, uint64_t hash)
+    {
+        size_t mask = slots.size() - 1;
+        for (size_t i = hash & mask;; i = (i + 1) & mask)
+        {
+            if (slots[i].inode == 0)
+            {
+                slots[i] = key;
+                return true;
+            }
+            if (slots[i].inode == key.inode && slots[i].device == key.device)
+            {
+                return false;
+            }
+        }
+    }
+
+    static void grow(Shard& shard)
+    {
+        std::vector<Key> slots(shard.slots.empty() ? 1024 : shard.slots.size() * 2, Key{ 0, 0 });
+        for (const auto& key : shard.slots)
+        {
+            if (key.inode != 0)
+            {
+                place(slots, key, mix(key.inode ^ (key.device * 0x9E3779B97F4A7C15ull)));
+            }
+        }
+        shard.slots.swap(slots);
+    }
+};
+
+// ScanOptions configures a ParallelScanner
+struct ScanOptions
+{
+    unsigned int threads{ 0 };          // Worker threads (0 = hardware concurrency)
+    bool apparentSize{ false };         // Rank files by st_size instead of allocated blocks
+    bool oneFileSystem{ false };        // Do not descend into directories on other filesystems
+    uintmax_t minFileSize{ 0 };         // Only files at least this large (by the ranking size) are collected
+    uint32_t maxDepth{ UINT32_MAX };    // Deepest directory level whose files are collected; the root is level 0.
+                                        // Deeper levels are still scanned, so directory totals stay complete
+};
+
+// A directory that could not be opened or read, so its subtree is missing from the totals
+struct UnreadableDirectory
+{
+    std::string path;
+    int error;                          // errno of the failed open or read
+};
+
+// ScanStatistics counts entries that were left out of the totals
+struct ScanStatistics
+{
+    static constexpr size_t MaxReportedUnreadable = 10;
+
+    uintmax_t duplicateHardlinks{ 0 };  // Extra links to an inode that was already counted
+    uintmax_t skippedMounts{ 0 };       // Directories on another filesystem (with oneFileSystem)
+    uintmax_t unreadableDirectories{ 0 };
+    std::vector<UnreadableDirectory> unreadable;    // The first MaxReportedUnreadable of them
+
+    void addUnreadable(std::string path, int error)
+    {
+        ++unreadableDirectories;
+        if (unreadable.size() < MaxReportedUnreadable)
+        {
+            unreadable.push_back({ std::move(path), error });
+        }
+    }
+
+    void merge(const ScanStatistics& other)
+    {
+        duplicateHardlinks += other.duplicateHardlinks;
+        skippedMounts += other.skippedMounts;
+        unreadableDirectories += other.unreadableDirectories;
+        for (const auto& directory : other.unreadable)
+        {
+            if (unreadable.size() < MaxReportedUnreadable)
+            {
+                unreadable.push_back(directory);
+            }
+        }
+    }
+};
+
+// ParallelScanner walks a directory tree with a pool of workers that claim directories from a shared
+// queue. Every directory is read through its own descriptor: subdirectories are opened with openat()
+// and entries are examined with fstatat(), so file paths are never built. Queued directories hold
+// their descriptor open, up to MaxQueuedDescriptors of them (fewer under a low RLIMIT_NOFILE); beyond
+// that a directory is queued by path and opened when a worker claims it, so the scan never holds more
+// than that bound plus one descriptor per worker. Directories that cannot be opened are counted and reported with
+// their errno. Each worker accumulates directory totals and its top-K heap privately; these are
+// merged once all workers finish.
+// Sizes follow du: allocated blocks are counted (directories included), every hardlinked inode is
+// counted once, and the scan can be confined to the filesystem of the root
+class ParallelScanner
+{
+public:
+    explicit ParallelScanner(const ScanOptions& options) : m_options(options)
+    {
+        if (m_options.threads == 0)
+        {
+            m_options.threads = std::thread::hardware_concurrency();
+            if (m_options.threads == 0)
+                m_options.threads = 2;
+        }
+    }
+
+    unsigned int threadCount() const
+    {
+        return m_options.threads;
+    }
+
+    const ScanStatistics& statistics() const
+    {
+        return m_statistics;
+    }
+
+    // Scans 'path' into 'tree', feeding every regular file that passes minFileSize and maxDepth to
+    // 'top' and 'files' when given. 'breakdown' classifies every counted file, regardless of minFileSize.
+    // Returns false if the root directory cannot be opened
+    bool scan(const std::string& path, DirectoryTree& tree, TopFiles* top = nullptr, FileList* files = nullptr,
+              FileBreakdown* breakdown = nullptr)
+    {
+        int rootFd = ::open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        struct stat rootStat;
+        if (rootFd < 0 || ::fstat(rootFd, &rootStat) != 0)
+        {
+            if (rootFd >= 0)
+                ::close(rootFd);
+            return false;
+        }
+
+        m_rootDevice = rootStat.st_dev;
+        m_nextId = 1;
+        m_pending = 1;
+        m_queuedDescriptors = 1;
+        m_maxQueuedDescriptors = MaxQueuedDescriptors;
+        struct rlimit limit;
+        if (::getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY)
+        {
+            // Leave room for the workers' own descriptors and whatever else the process has open
+            m_maxQueuedDescriptors = std::min<size_t>(MaxQueuedDescriptors, static_cast<size_t>(limit.rlim_cur) / 4);
+        }
+        m_statistics = ScanStatistics();
+        m_collectFiles = files != nullptr;
+        m_collectBreakdown = breakdown != nullptr;
+        int64_t now = static_cast<int64_t>(std::time(nullptr));
+        m_queue.push_back({ rootFd, 0, 0, 0, path, path, static_cast<uintmax_t>(rootStat.st_size),
+                            static_cast<uintmax_t>(rootStat.st_blocks) * 512 });
+
+        size_t topLimit = top ? top->limit() : 0;
+        std::vector<WorkerState> states;
+        states.reserve(m_options.threads);
+        for (unsigned int t = 0; t < m_options.threads; ++t)
+        {
+            states.emplace_back(topLimit, now);
+        }
+
+        std::vector<std::thread> workers;
+        for (unsigned int t = 0; t < m_options.threads; ++t)
+        {
+            workers.emplace_back(&ParallelScanner::workerLoop, this, std::ref(states[t]));
+        }
+        for (auto& worker : workers)
+        {
+            worker.join();
+        }
+
+        // Merge the per-thread results: nodes are placed by id, heaps are folded together
+        std::vector<DirectoryNode> nodes(m_nextId.load());
+        for (auto& state : states)
+        {
+            for (auto& entry : state.nodes)
+            {
+                nodes[entry.first] = std::move(entry.second);
+            }
+            if (top)
+            {
+                top->merge(state.top);
+            }
+            if (files)
+            {
+                files->merge(state.files);
+            }
+            if (breakdown)
+            {
+                breakdown->merge(state.breakdown);
+            }
+            m_statistics.merge(state.statistics);
+        }
+        tree.setNodes(std::move(nodes));
+        tree.finalise();
+        return true;
+    }
+
+private:
+    // Upper bound on queued directories that hold an open descriptor. Further directories are queued
+    // by path only
+    static constexpr size_t MaxQueuedDescriptors = 256;
+
+    // A directory waiting to be read: its open descriptor (-1 if it is to be opened by path), its node
+    // id, its parent's id, its depth below the root, its name and path, and the size of the directory
+    // inode itself (taken from the parent's fstatat)
+    struct WorkItem
+    {
+        int fd;
+        uint32_t id;
+        uint32_t parent;
+        uint32_t depth;
+        std::string name;
+        std::string path;
+        uintmax_t ownSize;
+        uintmax_t ownAllocated;
+    };
+
+    // Results gathered privately by one worker
+    struct WorkerState
+    {
+        std::vector<std::pair<uint32_t, DirectoryNode>> nodes;
+        TopFiles top;
+        FileList files;
+        FileBreakdown breakdown;
+        ScanStatistics statistics;
+
+        WorkerState(size_t topLimit, int64_t now) : top(topLimit), breakdown(now)
+        {
+        }
+    };
+
+    ScanOptions m_options;
+    std::deque<WorkItem> m_queue;
+    std::mutex m_queueMutex;
+    std::condition_variable m_queueCondVar;
+    size_t m_pending{ 0 };                  // Directories queued or being processed
+    size_t m_queuedDescriptors{ 0 };        // Queued directories holding an open descriptor
+    size_t m_maxQueuedDescriptors{ MaxQueuedDescriptors };
+    std::atomic<uint32_t> m_nextId{ 0 };
+    dev_t m_rootDevice{ 0 };
+    bool m_collectFiles{ false };
+    bool m_collectBreakdown{ false };
+    InodeSet m_seenInodes;
+    ScanStatistics m_statistics;
+
+    void workerLoop(WorkerState& state)
+    {
+        while (true)
+        {
+            WorkItem item;
+            {
+                std::unique_lock<std::mutex> lock(m_queueMutex);
+                m_queueCondVar.wait(lock, [this] { return !m_queue.empty() || m_pending == 0; });
+                if (m_queue.empty())
+                {
+                    return;
+                }
+                item = std::move(m_queue.front());
+                m_queue.pop_front();
+                if (item.fd >= 0)
+                {
+                    --m_queuedDescriptors;
+                }
+            }
+
+            processDirectory(item, state);
+
+            std::lock_guard<std::mutex> lock(m_queueMutex);
+            if (--m_pending == 0)
+            {
+                m_queueCondVar.notify_all();
+            }
+        }
+    }
+
+    // Hands a subdirectory to the shared queue, opening it first unless too many descriptors are
+    // already waiting or none are left. A descriptor slot is reserved under the lock, but the directory
+    // is opened outside it, so workers on a slow filesystem open directories concurrently. The node id
+    // is only taken once the directory is queued, so no id is left without a node. Returns false (with
+    // errno set) if the directory cannot be opened
+    bool enqueue(int parentFd, WorkItem& item)
+    {
+        bool reserved = false;
+        {
+            std::lock_guard<std::mutex> lock(m_queueMutex);
+            if (m_queuedDescriptors < m_maxQueuedDescriptors)
+            {
+                ++m_queuedDescriptors;
+                reserved = true;
+            }
+        }
+
+        if (reserved)
+        {
+            item.fd = ::openat(parentFd, item.name.c_str(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+            if (item.fd < 0)
+            {
+                int error = errno;
+                {
+                    std::lock_guard<std::mutex> lock(m_queueMutex);
+                    --m_queuedDescriptors;
+                }
+                errno = error;
+                if (error != EMFILE && error != ENFILE)
+                {
+                    return false;
+                }
+                // Out of descriptors: queue it by path, to be opened once some are free
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_queueMutex);
+            item.id = m_nextId++;
+            m_queue.push_back(std::move(item));
+            ++m_pending;
+        }
+        m_queueCondVar.notify_one();
+        return true;
+    }
+
+    // Reads one directory, accumulating its regular files into its node. Takes ownership of item.fd,
+    // or opens item.path if it has no descriptor yet
+    void processDirectory(WorkItem& item, WorkerState& state)
+    {
+        DirectoryNode node{ std::move(item.name), item.parent, item.ownSize, item.ownAllocated };
+        if (item.fd < 0)
+        {
+            item.fd = ::open(item.path.c_str(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+        }
+        DIR* dir = item.fd >= 0 ? ::fdopendir(item.fd) : nullptr;
+        if (!dir)
+        {
+            state.statistics.addUnreadable(item.path, errno);
+            if (item.fd >= 0)
+            {
+                ::close(item.fd);
+            }
+            state.nodes.emplace_back(item.id, std::move(node));
+            return;
+        }
+
+        int dirFd = item.fd;
+        while (true)
+        {
+            errno = 0;
+            struct dirent* entry = ::readdir(dir);
+            if (!entry)
+            {
+                if (errno != 0)
+                {
+                    state.statistics.addUnreadable(item.path, errno);
+                }
+                break;
+            }
+            const char* name = entry->d_name;
+            if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0')))
+            {
+                continue;
+            }
+
+            struct stat st;
+            if (::fstatat(dirFd, name, &st, AT_SYMLINK_NOFOLLOW) != 0)
+            {
+                continue;
+            }
+
+            if (S_ISDIR(st.st_mode))
+            {
+                if (m_options.oneFileSystem && st.st_dev != m_rootDevice)
+                {
+                    ++state.statistics.skippedMounts;
+                    continue;
+                }
+                std::string childPath = item.path.back() == '/' ? item.path + name : item.path + "/" + name;
+                WorkItem child{ -1, 0, item.id, item.depth + 1, name, childPath, static_cast<uintmax_t>(st.st_size),
+                                static_cast<uintmax_t>(st.st_blocks) * 512 };
+                if (!enqueue(dirFd, child))
+                {
+                    state.statistics.addUnreadable(std::move(childPath), errno);
+                }
+            }
+            else if (S_ISREG(st.st_mode))
+            {
+                if (st.st_nlink > 1 && !m_seenInodes.insert(st.st_dev, st.st_ino))
+                {
+                    ++state.statistics.duplicateHardlinks;
+                    continue;
+                }
+                ++node.fileCount;
+
+                uintmax_t apparent = static_cast<uintmax_t>(st.st_size);
+                uintmax_t allocated = static_cast<uintmax_t>(st.st_blocks) * 512;
+                node.size += apparent;
+                node.allocated += allocated;
+
+                uintmax_t rank = m_options.apparentSize ? apparent : allocated;
+                if (m_collectBreakdown)
+                {
+                    state.breakdown.add(name, rank, static_cast<int64_t>(st.st_mtim.tv_sec));
+                }
+                if (rank < m_options.minFileSize || item.depth > m_options.maxDepth)
+                {
+                    continue;
+                }
+                if (state.top.accepts(rank))
+                {
+                    state.top.add(rank, item.id, name);
+                }
+                if (m_collectFiles)
+                {
+                    state.files.add(apparent, allocated, item.id, name);
+                }
+            }
+        }
+        ::closedir(dir);
+        state.nodes.emplace_back(item.id, std::move(node));
+    }
+};
@@ -0,0 +1,259 @@
+#pragma once
+
+#include <cerrno>
+#include <charconv>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+extern "C"
+{
+    #include <unistd.h>
+}
+
+// Output formats of the non-interactive report
+enum class ReportFormat
+{
+    Csv,        // path,size,allocated with RFC 4180 quoting
+    Json,       // One array of {"path", "size", "allocated"} objects
+    Nul         // size<TAB>path<NUL>, the layout of du -0, safe for any file name
+};
+
+// ReportWriter formats report rows into a large in-memory buffer and hands it to write(2) in big
+// chunks, so that streaming millions of rows costs a few hundred system calls instead of one per line
+class ReportWriter
+{
+public:
+    explicit ReportWriter(ReportFormat format, int fd = STDOUT_FILENO, size_t bufferSize = 1u << 20)
+        : m_format(format), m_fd(fd), m_bufferSize(bufferSize)
+    {
+        m_buffer.reserve(bufferSize + 4096);
+        if (m_format == ReportFormat::Csv)
+        {
+            m_buffer += "path,size,allocated\n";
+        }
+        else if (m_format == ReportFormat::Json)
+        {
+            m_buffer += "[";
+        }
+    }
+
+    ~ReportWriter()
+    {
+        finish();
+    }
+
+    ReportWriter(const ReportWriter&) = delete;
+    ReportWriter& operator=(const ReportWriter&) = delete;
+
+    // Writes one row. The path is given as directory and name so the full path is never materialised
+    void write(std::string_view directory, std::string_view name, uintmax_t size, uintmax_t allocated)
+    {
+        switch (m_format)
+        {
+        case ReportFormat::Csv:
+            appendCsvPath(directory, name);
+            m_buffer += ',';
+            appendNumber(size);
+            m_buffer += ',';
+            appendNumber(allocated);
+            m_buffer += '\n';
+            break;
+        case ReportFormat::Json:
+            m_buffer += m_rows == 0 ? "\n{\"path\":\"" : ",\n{\"path\":\"";
+            appendJsonString(directory);
+            m_buffer += '/';
+            appendJsonString(name);
+            m_buffer += "\",\"size\":";
+            appendNumber(size);
+            m_buffer += ",\"allocated\":";
+            appendNumber(allocated);
+            m_buffer += '}';
+            break;
+        case ReportFormat::Nul:
+            appendNumber(sizeColumn(size, allocated));
+            m_buffer += '\t';
+            m_buffer.append(directory);
+            m_buffer += '/';
+            m_buffer.append(name);
+            m_buffer += '\0';
+            break;
+        }
+        ++m_rows;
+        if (m_buffer.size() >= m_bufferSize)
+        {
+            flush();
+        }
+    }
+
+    // Makes the NUL format print the apparent size instead of the allocated size
+    void useApparentSize(bool apparent)
+    {
+        m_apparent = apparent;
+    }
+
+    // Closes the document and writes out whatever is buffered. Returns false if a write failed
+    bool finish()
+    {
+        if (!m_finished)
+        {
+            m_finished = true;
+            if (m_format == ReportFormat::Json)
+            {
+                m_buffer += "\n]\n";
+            }
+            flush();
+        }
+        return m_ok;
+    }
+
+    uintmax_t rows() const
+    {
+        return m_rows;
+    }
+
+private:
+    ReportFormat m_format;
+    int m_fd;
+    size_t m_bufferSize;
+    std::string m_buffer;
+    uintmax_t m_rows{ 0 };
+    bool m_apparent{ false };
+    bool m_finished{ false };
+    bool m_ok{ true };
+
+    uintmax_t sizeColumn(uintmax_t size, uintmax_t allocated) const
+    {
+        return m_apparent ? size : allocated;
+    }
+
+    void flush()
+    {
+        const char* data = m_buffer.data();
+        size_t remaining = m_buffer.size();
+        while (m_ok && remaining > 0)
+        {
+            ssize_t written = ::write(m_fd, data, remaining);
+            if (written < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                m_ok = false;
+                break;
+            }
+            data += written;
+            remaining -= static_cast<size_t>(written);
+        }
+        m_buffer.clear();
+    }
+
+    void appendNumber(uintmax_t value)
+    {
+        char digits[24];
+        auto result = std::to_chars(digits, digits + sizeof(digits), value);
+        m_buffer.append(digits, result.ptr);
+    }
+
+    // Quotes the path only when it contains a separator, a quote or a line break
+    void appendCsvPath(std::string_view directory, std::string_view name)
+    {
+        auto needsQuotes = [](std::string_view s) { return s.find_first_of(",\"\r\n") != std::string_view::npos; };
+        if (!needsQuotes(directory) && !needsQuotes(name))
+        {
+            m_buffer.append(directory);
+            m_buffer += '/';
+            m_buffer.append(name);
+            return;
+        }
+        m_buffer += '"';
+        for (std::string_view part : { directory, std::string_view("/"), name })
+        {
+            for (char c : part)
+            {
+                if (c == '"')
+                    m_buffer += '"';
+                m_buffer += c;
+            }
+        }
+        m_buffer += '"';
+    }
+
+    // File names are raw bytes and JSON text must be UTF-8. Control characters and JSON
+    // metacharacters are escaped, valid UTF-8 sequences are copied through, and every byte that is not
+    // part of one is written as \u00XX (its Latin-1 reading), so the document stays valid and the
+    // byte value can still be recovered
+    void appendJsonString(std::string_view s)
+    {
+        static const char hex[] = "0123456789abcdef";
+        for (size_t i = 0; i < s.size();)
+        {
+            unsigned char c = static_cast<unsigned char>(s[i]);
+            if (c == '"' || c == '\\')
+            {
+                m_buffer += '\\';
+                m_buffer += static_cast<char>(c);
+                ++i;
+            }
+            else if (c < 0x20 || c >= 0x80)
+            {
+                size_t length = c < 0x80 ? 0 : utf8SequenceLength(s, i);
+                if (length > 0)
+                {
+                    m_buffer.append(s.substr(i, length));
+                    i += length;
+                    continue;
+                }
+                m_buffer += "\\u00";
+                m_buffer += hex[c >> 4];
+                m_buffer += hex[c & 0xF];
+                ++i;
+            }
+            else
+            {
+                m_buffer += static_cast<char>(c);
+                ++i;
+            }
+        }
+    }
+
+    // Length of the well-formed UTF-8 sequence starting at s[i], or 0 if there is none (a stray
+    // continuation byte, a truncated sequence, an overlong form, a surrogate or a code point above
+    // U+10FFFF)
+    static size_t utf8SequenceLength(std::string_view s, size_t i)
+    {
+        unsigned char c = static_cast<unsigned char>(s[i]);
+        size_t length;
+        unsigned char low = 0x80;       // Bounds of the second byte, which rule out the invalid forms
+        unsigned char high = 0xBF;
+        if (c >= 0xC2 && c <= 0xDF)
+            length = 2;
+        else if (c >= 0xE0 && c <= 0xEF)
+        {
+            length = 3;
+            low = c == 0xE0 ? 0xA0 : 0x80;
+            high = c == 0xED ? 0x9F : 0xBF;
+        }
+        else if (c >= 0xF0 && c <= 0xF4)
+        {
+            length = 4;
+            low = c == 0xF0 ? 0x90 : 0x80;
+            high = c == 0xF4 ? 0x8F : 0xBF;
+        }
+        else
+            return 0;
+
+        if (i + length > s.size())
+        {
+            return 0;
+        }
+        for (size_t k = 1; k < length; ++k)
+        {
+            unsigned char next = static_cast<unsigned char>(s[i + k]);
+            if (k == 1 ? (next < low || next > high) : (next < 0x80 || next > 0xBF))
+            {
+                return 0;
+            }
+        }
+        return length;
+    }
+};
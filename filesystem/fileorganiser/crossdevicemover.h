@@ -0,0 +1,235 @@
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+extern "C"
+{
+    #include <fcntl.h>
+    #include <sys/sendfile.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+}
+
+// CrossDeviceMover moves files between filesystems, where rename(2) fails with EXDEV. Data is copied
+// inside the kernel with copy_file_range(2), falling back to sendfile(2) where the filesystems do not
+// support it, and the copy keeps the permission bits and timestamps of the source.
+// A source is only unlinked once its copy is durable. Rather than fsync every file, copies are
+// grouped into batches and each batch is made durable with one syncfs(2) per target filesystem, after
+// which its sources are unlinked, unless a source changed after it was copied. Each copy is closed as soon as it is written; only one descriptor per
+// target filesystem stays open for the syncfs, so a batch holds no more descriptors than there are
+// target filesystems. One mover is meant to be owned by a single worker thread
+class CrossDeviceMover
+{
+public:
+    explicit CrossDeviceMover(size_t batchFiles = 256, uintmax_t batchBytes = uintmax_t(256) << 20)
+        : m_batchFiles(batchFiles), m_batchBytes(batchBytes)
+    {
+    }
+
+    ~CrossDeviceMover()
+    {
+        flush();
+    }
+
+    CrossDeviceMover(const CrossDeviceMover&) = delete;
+    CrossDeviceMover& operator=(const CrossDeviceMover&) = delete;
+
+    // Copies 'source' to 'target', which must not exist yet. The source is removed when the batch
+    // holding the copy is flushed, and 'id' is then added to completed(). Returns false (and removes
+    // any partial copy) if the copy failed
+    bool move(const std::string& source, const std::string& target, size_t id = 0)
+    {
+        int in = ::open(source.c_str(), O_RDONLY | O_CLOEXEC);
+        struct stat st;
+        if (in < 0 || ::fstat(in, &st) != 0)
+        {
+            fail(source, errno, in);
+            return false;
+        }
+
+        int out = ::open(target.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, st.st_mode & 07777);
+        if (out < 0)
+        {
+            fail(target, errno, in);
+            return false;
+        }
+
+        // The umask may have narrowed the mode given to open(), so it is set again explicitly
+        struct timespec times[2] = { st.st_atim, st.st_mtim };
+        if (!copyData(in, out, static_cast<uintmax_t>(st.st_size)) || ::fchmod(out, st.st_mode & 07777) != 0 ||
+            ::futimens(out, times) != 0)
+        {
+            int error = errno;
+            ::close(out);
+            ::unlink(target.c_str());
+            fail(source, error, in);
+            return false;
+        }
+        ::close(in);
+
+        struct stat targetStat;
+        ::fstat(out, &targetStat);
+        auto syncTarget = std::find_if(m_syncTargets.begin(), m_syncTargets.end(),
+                                       [&](const SyncTarget& t) { return t.device == targetStat.st_dev; });
+        if (syncTarget == m_syncTargets.end())
+        {
+            m_syncTargets.push_back({ targetStat.st_dev, out });
+        }
+        else
+        {
+            ::close(out);
+        }
+        m_pending.push_back({ targetStat.st_dev, source, target, id, st.st_ino, st.st_size, st.st_mtim });
+        m_pendingBytes += static_cast<uintmax_t>(st.st_size);
+        m_bytesCopied += static_cast<uintmax_t>(st.st_size);
+
+        if (m_pending.size() >= m_batchFiles || m_pendingBytes >= m_batchBytes)
+        {
+            flush();
+        }
+        return true;
+    }
+
+    // Makes every pending copy durable, then unlinks the sources. Returns false if anything failed;
+    // sources whose copy could not be synced are left in place, and so are sources that were replaced
+    // or modified since they were copied, whose stale copy is removed instead
+    bool flush()
+    {
+        bool ok = true;
+        std::vector<dev_t> failed;
+        for (const auto& target : m_syncTargets)
+        {
+            if (::syncfs(target.fd) != 0)
+            {
+                failed.push_back(target.device);
+                m_errors.push_back(std::string("syncing copies: ") + std::strerror(errno));
+                ok = false;
+            }
+            ::close(target.fd);
+        }
+        m_syncTargets.clear();
+
+        for (const auto& pending : m_pending)
+        {
+            if (std::find(failed.begin(), failed.end(), pending.device) != failed.end())
+            {
+                continue;
+            }
+            if (!unchanged(pending))
+            {
+                ::unlink(pending.target.c_str());
+                m_errors.push_back(pending.source + " changed while being moved; it was left in place");
+                ok = false;
+            }
+            else if (::unlink(pending.source.c_str()) != 0)
+            {
+                m_errors.push_back("removing " + pending.source + " after copying: " + std::strerror(errno));
+                ok = false;
+            }
+            else
+            {
+                m_completed.push_back(pending.id);
+                ++m_filesMoved;
+            }
+        }
+        m_pending.clear();
+        m_pendingBytes = 0;
+        return ok;
+    }
+
+    uintmax_t bytesCopied() const { return m_bytesCopied; }
+    size_t filesMoved() const { return m_filesMoved; }
+
+    // Ids of the moves whose source has been removed, in the order their batches were flushed
+    const std::vector<size_t>& completed() const { return m_completed; }
+
+    // Messages for every failure so far, including those reported later by flush()
+    const std::vector<std::string>& errors() const { return m_errors; }
+
+private:
+    // A copy that has been written but not yet synced, so its source still exists. The identity,
+    // size and mtime the source had when the copy started are kept to detect later changes
+    struct Pending
+    {
+        dev_t device;
+        std::string source;
+        std::string target;
+        size_t id;
+        ino_t inode;
+        off_t size;
+        struct timespec mtime;
+    };
+
+    // An open copy on a target filesystem of the current batch, kept for syncfs
+    struct SyncTarget
+    {
+        dev_t device;
+        int fd;
+    };
+
+    size_t m_batchFiles;
+    uintmax_t m_batchBytes;
+    std::vector<Pending> m_pending;
+    std::vector<SyncTarget> m_syncTargets;
+    uintmax_t m_pendingBytes{ 0 };
+    uintmax_t m_bytesCopied{ 0 };
+    size_t m_filesMoved{ 0 };
+    std::vector<size_t> m_completed;
+    std::vector<std::string> m_errors;
+
+    // Whether the source is still the file, with the same size and mtime, that was copied
+    static bool unchanged(const Pending& pending)
+    {
+        struct stat st;
+        return ::lstat(pending.source.c_str(), &st) == 0 && st.st_ino == pending.inode && st.st_size == pending.size &&
+               st.st_mtim.tv_sec == pending.mtime.tv_sec && st.st_mtim.tv_nsec == pending.mtime.tv_nsec;
+    }
+
+    void fail(const std::string& path, int error, int fd)
+    {
+        m_errors.push_back(path + ": " + std::strerror(error));
+        if (fd >= 0)
+        {
+            ::close(fd);
+        }
+    }
+
+    // Copies 'size' bytes in the kernel. copy_file_range may refuse (EXDEV on older kernels, EINVAL
+    // or EOPNOTSUPP on some filesystems) before copying anything, in which case sendfile takes over
+    static bool copyData(int in, int out, uintmax_t size)
+    {
+        bool useSendfile = false;
+        uintmax_t copied = 0;
+        while (copied < size)
+        {
+            size_t chunk = static_cast<size_t>(std::min<uintmax_t>(size - copied, uintmax_t(1) << 30));
+            ssize_t n = useSendfile ? ::sendfile(out, in, nullptr, chunk)
+                                    : ::copy_file_range(in, nullptr, out, nullptr, chunk, 0);
+            if (n < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                if (!useSendfile && copied == 0 &&
+                    (errno == EXDEV || errno == EINVAL || errno == ENOSYS || errno == EOPNOTSUPP))
+                {
+                    useSendfile = true;
+                    continue;
+                }
+                return false;
+            }
+            if (n == 0)
+            {
+                break;      // The source shrank while being copied
+            }
+            copied += static_cast<uintmax_t>(n);
+        }
+        return true;
+    }
+};
@@ -1,89 +1,962 @@
 #include <iostream>
 #include <filesystem>
 #include <unordered_map>
+#include <unordered_set>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cctype>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdint>
+#include <csignal>
+#include <cstring>
+#include <deque>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+extern "C"
+{
+    #include <dirent.h>
+    #include <fcntl.h>
+    #include <poll.h>
+    #include <signal.h>
+    #include <stdio.h>
+    #include <sys/inotify.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+}
+#include "crossdevicemover.h"
+#include "filesniffer.h"
+#include "organiserrules.h"
 
 namespace fs = std::filesystem;
 
-// FileOrganiser class scans a directory and moves files into categorized folders
+// Set by the SIGINT/SIGTERM handler to end FileOrganiser::watch
+static volatile std::sig_atomic_t stopRequested = 0;
+
+// OrganiseOptions configures a FileOrganiser run
+struct OrganiseOptions
+{
+    unsigned int threads{ 0 };      // Worker threads used to execute the plan (0 = hardware concurrency)
+    bool dryRun{ false };           // Print the plan instead of executing it
+    bool sniffContent{ true };      // Classify by file signature first, falling back to the extension
+    std::string targetRoot;         // Where category folders are created (empty = the organised directory)
+    std::string rulesFile;          // Rules to load instead of the built-in ones
+    bool recursive{ false };        // Also organise the files of subdirectories
+    bool watch{ false };            // Keep running and organise files as they arrive
+};
+
+// PlannedMove is one entry of the move plan: where a file is and where it will go
+struct PlannedMove
+{
+    fs::path source;
+    fs::path target;
+    std::string category;           // Target folder relative to the target root
+};
+
+// FileOrganiser class scans a directory and moves files into categorized folders chosen by a RuleSet.
+// It works in two phases: the directory is walked once and a complete move plan is built in memory,
+// with every name collision already resolved; the plan is then executed by a pool of workers. The
+// directory is therefore never modified while it is being iterated
 class FileOrganiser
 {
 private:
-    // Mapping file extensions to folder names
-    std::unordered_map<std::string, std::string> categoryMap =
-    {
-        { ".jpg", "Images" },
-        { ".png", "Images" },
-        { ".gif", "Images" },
-        { ".bmp", "Images" },
-        { ".txt", "Documents" },
-        { ".pdf", "Documents" },
-        { ".docx", "Documents" },
-        { ".xlsx", "Documents" },
-        { ".mp4", "Videos" },
-        { ".mkv", "Videos" },
-        { ".avi", "Videos" },
-        { ".mp3", "Audio" },
-        { ".wav", "Audio" },
-        { ".flac", "Audio" },
-        { ".zip", "Archives" },
-        { ".rar", "Archives" },
-        { ".tar", "Archives" }
+    // Built-in rules: a recognised file signature wins, then the extension decides
+    static constexpr const char* DefaultRules = R"(
+        type *                      -> {type}
+        ext jpg png gif bmp         -> Images
+        ext txt pdf docx xlsx       -> Documents
+        ext mp4 mkv avi             -> Videos
+        ext mp3 wav flac            -> Audio
+        ext zip rar tar             -> Archives
+        any                         -> Others
+    )";
+
+    OrganiseOptions m_options;
+    RuleSet m_rules;
+    bool m_rulesLoaded{ false };
+
+    // Names known to be taken in each target folder. Kept between watch batches, so a new file costs
+    // the same however full its folder already is
+    std::unordered_map<std::string, std::unordered_set<std::string>> m_takenNames;
+
+    // Runs task(i) for every i in [0, count) on the worker pool and returns the number of threads used
+    template <typename Task>
+    unsigned int runParallel(size_t count, Task task)
+    {
+        std::atomic<size_t> nextIndex{ 0 };
+        auto worker = [&]()
+        {
+            for (size_t i = nextIndex++; i < count; i = nextIndex++)
+            {
+                task(i);
+            }
+        };
+
+        unsigned int numThreads = static_cast<unsigned int>(std::min<size_t>(m_options.threads, std::max<size_t>(count, 1)));
+        std::vector<std::thread> threads;
+        for (unsigned int t = 0; t < numThreads; ++t)
+        {
+            threads.emplace_back(worker);
+        }
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+        return numThreads;
+    }
+
+    // Returns 'name' if it is free, otherwise the first free "stem (n).ext"
+    static std::string uniqueName(const std::string& name, std::unordered_set<std::string>& taken)
+    {
+        if (taken.insert(name).second)
+        {
+            return name;
+        }
+        fs::path original(name);
+        std::string stem = original.stem().string();
+        std::string extension = original.extension().string();
+        for (size_t n = 1;; ++n)
+        {
+            std::string candidate = stem + " (" + std::to_string(n) + ")" + extension;
+            if (taken.insert(candidate).second)
+            {
+                return candidate;
+            }
+        }
+    }
+
+    // The rules' output folders inside the organised tree: the subdirectories of the target root
+    // whose names a target can expand to, e.g. "Images", or "2024" for "{year}/{month}"
+    struct OutputFolders
+    {
+        const RuleSet* rules{ nullptr };
+        bool inside{ false };           // The target root lies inside the organised tree
+        std::string root;               // The target root relative to the organised directory ("" for itself)
+
+        // 'relative' is a directory path relative to the organised directory
+        bool contains(const std::string& relative) const
+        {
+            if (!inside)
+            {
+                return false;
+            }
+            size_t slash = relative.rfind('/');
+            std::string_view parent = slash == std::string::npos ? std::string_view() : std::string_view(relative).substr(0, slash);
+            return parent == root && rules->isOutputFolder(std::string_view(relative).substr(slash == std::string::npos ? 0 : slash + 1));
+        }
     };
 
-    // Returns the category based on file extension
-    std::string getCategory(const fs::path& filePath)
+    OutputFolders skippedFolders(const fs::path& directory, const fs::path& targetRoot) const
+    {
+        OutputFolders skipped;
+        skipped.rules = &m_rules;
+        fs::path relative = fs::absolute(targetRoot).lexically_normal().lexically_relative(fs::absolute(directory).lexically_normal());
+        if (!relative.empty() && *relative.begin() != "..")
+        {
+            skipped.inside = true;
+            skipped.root = relative == "." ? std::string() : relative.string();
+            while (!skipped.root.empty() && skipped.root.back() == '/')
+            {
+                skipped.root.pop_back();
+            }
+        }
+        return skipped;
+    }
+
+    // Evaluates the rules for one regular file of 'parent' and appends its move. Files with no matching
+    // rule, or already in their folder, stay where they are. 'st' may be null when no rule needs it
+    void planFile(std::string source, const std::string& relative, const char* name, const struct stat* st,
+                  const fs::path& parent, const fs::path& targetRoot, std::vector<PlannedMove>& moves) const
+    {
+        RuleSet::File file{ source, relative, name,
+                            st ? static_cast<uintmax_t>(st->st_size) : 0,
+                            st ? static_cast<int64_t>(st->st_mtime) : 0 };
+        std::string folder = m_rules.evaluate(file, m_options.sniffContent);
+        if (!folder.empty() && (targetRoot / folder).lexically_normal() != parent.lexically_normal())
+        {
+            moves.push_back({ std::move(source), fs::path(), std::move(folder) });
+        }
+    }
+
+    // Walks the directory (recursively if requested) with a pool of workers that claim directories
+    // from a shared queue, evaluating the rules for every regular file as it is found. Directories
+    // that the rules write into are not entered, so organised files are not picked up again
+    std::vector<PlannedMove> collectMoves(const fs::path& directory, const fs::path& targetRoot)
+    {
+        OutputFolders skipped = skippedFolders(directory, targetRoot);
+        std::deque<std::string> queue{ std::string() };        // Paths relative to 'directory'
+        size_t pending = 1;                                     // Directories queued or being read
+        std::mutex queueMutex;
+        std::condition_variable queueCondVar;
+        std::vector<std::vector<PlannedMove>> found(m_options.threads);
+        std::string root = directory.string();
+        bool needsStat = m_rules.needsStat();
+
+        auto worker = [&](std::vector<PlannedMove>& moves)
+        {
+            while (true)
+            {
+                std::string relative;
+                {
+                    std::unique_lock<std::mutex> lock(queueMutex);
+                    queueCondVar.wait(lock, [&] { return !queue.empty() || pending == 0; });
+                    if (queue.empty())
+                    {
+                        return;
+                    }
+                    relative = std::move(queue.front());
+                    queue.pop_front();
+                }
+
+                std::string path = relative.empty() ? root : root + "/" + relative;
+                if (DIR* dir = ::opendir(path.c_str()))
+                {
+                    while (struct dirent* entry = ::readdir(dir))
+                    {
+                        const char* name = entry->d_name;
+                        if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0')))
+                        {
+                            continue;
+                        }
+                        std::string childRelative = relative.empty() ? name : relative + "/" + name;
+
+                        unsigned char type = entry->d_type;
+                        struct stat st{};
+                        bool haveStat = false;
+                        if (type == DT_UNKNOWN || (type == DT_REG && needsStat))
+                        {
+                            if (::fstatat(::dirfd(dir), name, &st, AT_SYMLINK_NOFOLLOW) != 0)
+                            {
+                                continue;
+                            }
+                            haveStat = true;
+                            type = S_ISDIR(st.st_mode) ? DT_DIR : S_ISREG(st.st_mode) ? DT_REG : DT_UNKNOWN;
+                        }
+
+                        if (type == DT_DIR)
+                        {
+                            if (m_options.recursive && !skipped.contains(childRelative))
+                            {
+                                std::lock_guard<std::mutex> lock(queueMutex);
+                                queue.push_back(std::move(childRelative));
+                                ++pending;
+                                queueCondVar.notify_one();
+                            }
+                        }
+                        else if (type == DT_REG)
+                        {
+                            planFile(root + "/" + childRelative, childRelative, name, haveStat ? &st : nullptr,
+                                     path, targetRoot, moves);
+                        }
+                    }
+                    ::closedir(dir);
+                }
+                else
+                {
+                    std::cerr << "Error reading directory " << path << ": " << std::strerror(errno) << "\n";
+                }
+
+                std::lock_guard<std::mutex> lock(queueMutex);
+                if (--pending == 0)
+                {
+                    queueCondVar.notify_all();
+                }
+            }
+        };
+
+        std::vector<std::thread> threads;
+        for (unsigned int t = 0; t < m_options.threads; ++t)
+        {
+            threads.emplace_back(worker, std::ref(found[t]));
+        }
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+
+        // Sorting makes the plan, and therefore the collision suffixes, independent of thread timing
+        std::vector<PlannedMove> plan;
+        for (auto& moves : found)
+        {
+            std::move(moves.begin(), moves.end(), std::back_inserter(plan));
+        }
+        std::sort(plan.begin(), plan.end(), [](const PlannedMove& a, const PlannedMove& b) { return a.source < b.source; });
+        return plan;
+    }
+
+    // Gives every move a target name. Names already present in a target folder, and names claimed
+    // earlier (in this plan or, when watching, in earlier batches), are never overwritten
+    void resolveTargets(std::vector<PlannedMove>& plan, const fs::path& targetRoot)
+    {
+        std::unordered_set<std::string> unusable;
+        for (auto& move : plan)
+        {
+            auto it = m_takenNames.find(move.category);
+            if (it == m_takenNames.end())
+            {
+                // First file for this folder: record what the folder already holds
+                it = m_takenNames.emplace(move.category, std::unordered_set<std::string>()).first;
+                fs::path folder = targetRoot / move.category;
+                std::error_code error;
+                if (fs::exists(folder, error) && !fs::is_directory(folder, error))
+                {
+                    std::cerr << "Skipping folder " << move.category << ": " << folder << " is not a directory" << std::endl;
+                    unusable.insert(move.category);
+                    m_takenNames.erase(it);
+                }
+                else if (fs::is_directory(folder, error))
+                {
+                    for (fs::directory_iterator entry(folder, error), end; !error && entry != end; entry.increment(error))
+                    {
+                        it->second.insert(entry->path().filename().string());
+                    }
+                    if (error)
+                    {
+                        std::cerr << "Skipping folder " << move.category << ": " << error.message() << std::endl;
+                        unusable.insert(move.category);
+                        m_takenNames.erase(it);
+                    }
+                }
+            }
+            if (unusable.count(move.category) == 0)
+            {
+                move.target = targetRoot / move.category / uniqueName(move.source.filename().string(), it->second);
+            }
+        }
+
+        plan.erase(std::remove_if(plan.begin(), plan.end(), [](const PlannedMove& move) { return move.target.empty(); }),
+                   plan.end());
+    }
+
+    // Builds the complete move plan for a directory
+    std::vector<PlannedMove> buildPlan(const fs::path& directory, const fs::path& targetRoot)
+    {
+        std::vector<PlannedMove> plan = collectMoves(directory, targetRoot);
+        resolveTargets(plan, targetRoot);
+        return plan;
+    }
+
+    // Prints the plan, one move per line, through a single buffered stream
+    void printPlan(const std::vector<PlannedMove>& plan, const fs::path& targetRoot)
+    {
+        std::ostringstream out;
+        for (const auto& move : plan)
+        {
+            out << move.source.filename().string() << " -> " << move.target.lexically_relative(targetRoot).string() << "\n";
+        }
+        std::cout << out.str();
+        std::cout << plan.size() << " files would be moved." << std::endl;
+    }
+
+    // Moves one file without ever replacing an existing target and returns 0 or the errno value.
+    // renameat2(RENAME_NOREPLACE) makes the check and the move atomic. Filesystems that do not support
+    // the flag fall back to link(2) and unlink(2), as link fails with EEXIST rather than replacing.
+    // Filesystems without hard links either get rename(2) right after checking that the target is free
+    static int moveFile(const PlannedMove& move)
+    {
+        const char* source = move.source.c_str();
+        const char* target = move.target.c_str();
+        if (::renameat2(AT_FDCWD, source, AT_FDCWD, target, RENAME_NOREPLACE) == 0)
+        {
+            return 0;
+        }
+        if (errno != EINVAL)
+        {
+            return errno;
+        }
+
+        if (::link(source, target) == 0)
+        {
+            if (::unlink(source) == 0)
+            {
+                return 0;
+            }
+            int error = errno;
+            ::unlink(target);
+            return error;
+        }
+        if (errno != EPERM && errno != EOPNOTSUPP)
+        {
+            return errno;
+        }
+
+        struct stat st;
+        if (::lstat(target, &st) == 0)
+        {
+            return EEXIST;
+        }
+        if (errno != ENOENT)
+        {
+            return errno;
+        }
+        return ::rename(source, target) == 0 ? 0 : errno;
+    }
+
+    // Copies the moves that rename() could not perform because the target is on another filesystem.
+    // Every worker owns a CrossDeviceMover, so copies are synced in per-worker batches
+    void copyAcrossDevices(const std::vector<PlannedMove>& plan, const std::vector<size_t>& indices,
+                           std::vector<char>& moved, std::atomic<size_t>& failures)
+    {
+        std::atomic<size_t> nextIndex{ 0 };
+        std::atomic<uintmax_t> bytesCopied{ 0 };
+        std::mutex errorMutex;
+
+        auto worker = [&]()
+        {
+            CrossDeviceMover mover;
+            for (size_t i = nextIndex++; i < indices.size(); i = nextIndex++)
+            {
+                const PlannedMove& move = plan[indices[i]];
+                mover.move(move.source.string(), move.target.string(), indices[i]);
+            }
+            mover.flush();
+            bytesCopied += mover.bytesCopied();
+
+            // A move only counts once its copy is durable and its source is gone
+            for (size_t index : mover.completed())
+            {
+                moved[index] = 1;
+            }
+
+            // Failed copies and failed unlinks both count against the plan; a copy whose source could
+            // not be removed has still been duplicated, which the user must resolve
+            failures += mover.errors().size();
+            std::lock_guard<std::mutex> lock(errorMutex);
+            for (const auto& error : mover.errors())
+            {
+                std::cerr << "Error moving across filesystems: " << error << "\n";
+            }
+        };
+
+        unsigned int numThreads = static_cast<unsigned int>(std::min<size_t>(m_options.threads, indices.size()));
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> threads;
+        for (unsigned int t = 0; t < numThreads; ++t)
+        {
+            threads.emplace_back(worker);
+        }
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        double megabytes = static_cast<double>(bytesCopied.load()) / (1024.0 * 1024.0);
+        std::cout << "Copied " << indices.size() << " files (" << std::fixed << std::setprecision(1) << megabytes
+                  << " MB) across filesystems in " << std::setprecision(3) << seconds << " s using " << numThreads
+                  << " threads (" << std::setprecision(1) << (seconds > 0 ? megabytes / seconds : 0.0) << " MB/s)" << std::endl;
+    }
+
+    // Creates each category folder once, then lets the workers claim moves through a shared index.
+    // A folder that cannot be created fails its own moves only. Returns the number of failed moves
+    size_t executePlan(const std::vector<PlannedMove>& plan)
+    {
+        std::map<std::string, size_t> movedPerCategory;
+        std::unordered_set<std::string> unusable;
+        for (const auto& move : plan)
+        {
+            if (movedPerCategory.emplace(move.category, 0).second)
+            {
+                std::error_code error;
+                fs::create_directories(move.target.parent_path(), error);
+                if (error)
+                {
+                    std::cerr << "Error creating folder " << move.target.parent_path().string() << ": " << error.message() << "\n";
+                    unusable.insert(move.category);
+                }
+            }
+        }
+
+        std::atomic<size_t> failures{ 0 };
+        std::vector<char> moved(plan.size(), 0);
+        std::vector<size_t> crossDevice;
+        std::mutex errorMutex;
+
+        auto start = std::chrono::steady_clock::now();
+        unsigned int numThreads = runParallel(plan.size(), [&](size_t i)
+        {
+            if (!unusable.empty() && unusable.count(plan[i].category) != 0)
+            {
+                ++failures;
+                return;
+            }
+            int error = moveFile(plan[i]);
+            if (error == 0)
+            {
+                moved[i] = 1;
+                return;
+            }
+            std::lock_guard<std::mutex> lock(errorMutex);
+            if (error == EXDEV)
+            {
+                crossDevice.push_back(i);
+            }
+            else
+            {
+                ++failures;
+                std::cerr << "Error moving " << plan[i].source.string() << ": " << std::strerror(error) << "\n";
+            }
+        });
+
+        if (!crossDevice.empty())
+        {
+            std::sort(crossDevice.begin(), crossDevice.end());
+            copyAcrossDevices(plan, crossDevice, moved, failures);
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        for (size_t i = 0; i < plan.size(); ++i)
+        {
+            if (moved[i])
+            {
+                ++movedPerCategory[plan[i].category];
+            }
+        }
+        for (const auto& category : movedPerCategory)
+        {
+            std::cout << "Moved " << category.second << " files -> " << category.first << "/" << std::endl;
+        }
+
+        size_t total = static_cast<size_t>(std::count(moved.begin(), moved.end(), 1));
+        std::cout << "Moved " << total << " files in " << std::fixed << std::setprecision(3) << seconds << " s using "
+                  << numThreads << " threads (" << std::setprecision(0) << (seconds > 0 ? total / seconds : 0.0)
+                  << " files/s)";
+        if (failures > 0)
+        {
+            std::cout << ", " << failures << " failed";
+        }
+        std::cout << std::endl;
+        return failures;
+    }
+
+    // Checks the directory and loads the rules on first use. Returns false (after reporting) on error
+    bool prepare(const std::string& directory)
     {
-        std::string ext = filePath.extension().string();
-        if (categoryMap.find(ext) != categoryMap.end())
+        if (!fs::exists(directory) || !fs::is_directory(directory))
         {
-            return categoryMap[ext];
+            std::cerr << "Invalid directory path!" << std::endl;
+            return false;
+        }
+
+        if (!m_rulesLoaded)
+        {
+            std::string error;
+            std::istringstream defaults(DefaultRules);
+            bool loaded = m_options.rulesFile.empty() ? m_rules.parse(defaults, error) : m_rules.load(m_options.rulesFile, error);
+            if (!loaded)
+            {
+                std::cerr << "Error in rules: " << error << std::endl;
+                return false;
+            }
+            m_rulesLoaded = true;
+        }
+        return true;
+    }
+
+    // Adds an inotify watch on 'relative' (a path inside 'root') and, when organising recursively, on
+    // every subdirectory that is not an output folder. Files already present are added to 'existing'
+    // if it is given, to pick up files that landed before the watch existed
+    void addWatches(int inotifyFd, const std::string& root, const std::string& relative,
+                    const OutputFolders& skipped, std::unordered_map<int, std::string>& watched,
+                    std::unordered_set<std::string>* existing)
+    {
+        std::string path = relative.empty() ? root : root + "/" + relative;
+        uint32_t mask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_ONLYDIR;
+        if (m_options.recursive)
+        {
+            mask |= IN_CREATE | IN_MOVE_SELF;       // New subdirectories, and watched ones moved away
+        }
+        int wd = ::inotify_add_watch(inotifyFd, path.c_str(), mask);
+        if (wd < 0)
+        {
+            std::cerr << "Error watching " << path << ": " << std::strerror(errno) << std::endl;
+            return;
+        }
+        watched[wd] = relative;
+
+        if (!m_options.recursive && existing == nullptr)
+        {
+            return;
+        }
+        DIR* dir = ::opendir(path.c_str());
+        if (dir == nullptr)
+        {
+            return;
+        }
+        while (struct dirent* entry = ::readdir(dir))
+        {
+            const char* name = entry->d_name;
+            if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0')))
+            {
+                continue;
+            }
+            std::string childRelative = relative.empty() ? name : relative + "/" + name;
+            unsigned char type = entry->d_type;
+            struct stat st;
+            if (type == DT_UNKNOWN && ::fstatat(::dirfd(dir), name, &st, AT_SYMLINK_NOFOLLOW) == 0)
+            {
+                type = S_ISDIR(st.st_mode) ? DT_DIR : S_ISREG(st.st_mode) ? DT_REG : DT_UNKNOWN;
+            }
+            if (type == DT_DIR && m_options.recursive && !skipped.contains(childRelative))
+            {
+                addWatches(inotifyFd, root, childRelative, skipped, watched, existing);
+            }
+            else if (type == DT_REG && existing != nullptr)
+            {
+                existing->insert(std::move(childRelative));
+            }
+        }
+        ::closedir(dir);
+    }
+
+    // Plans and executes the moves for a batch of files reported by inotify, given relative to 'root'.
+    // Files that have gone away since their event are ignored. If a move fails, for example because
+    // another program took the name, the cached folder listings are dropped and the rest is retried once
+    void organiseBatch(const std::string& root, const fs::path& targetRoot, const std::unordered_set<std::string>& files)
+    {
+        std::vector<std::string> sorted(files.begin(), files.end());
+        std::sort(sorted.begin(), sorted.end());
+
+        for (int attempt = 0; attempt < 2; ++attempt)
+        {
+            std::vector<PlannedMove> plan;
+            for (const auto& relative : sorted)
+            {
+                std::string source = root + "/" + relative;
+                struct stat st;
+                if (::fstatat(AT_FDCWD, source.c_str(), &st, AT_SYMLINK_NOFOLLOW) != 0 || !S_ISREG(st.st_mode))
+                {
+                    continue;
+                }
+                size_t slash = relative.rfind('/');
+                const char* name = relative.c_str() + (slash == std::string::npos ? 0 : slash + 1);
+                fs::path parent = slash == std::string::npos ? fs::path(root) : fs::path(root) / relative.substr(0, slash);
+                planFile(std::move(source), relative, name, &st, parent, targetRoot, plan);
+            }
+            if (plan.empty())
+            {
+                return;
+            }
+
+            resolveTargets(plan, targetRoot);
+            if (m_options.dryRun)
+            {
+                printPlan(plan, targetRoot);
+                return;
+            }
+            if (executePlan(plan) == 0)
+            {
+                return;
+            }
+            m_takenNames.clear();
         }
-        return "Others";
     }
 
 public:
+    explicit FileOrganiser(const OrganiseOptions& options = OrganiseOptions()) : m_options(options)
+    {
+        if (m_options.threads == 0)
+        {
+            m_options.threads = std::thread::hardware_concurrency();
+            if (m_options.threads == 0)
+                m_options.threads = 2;
+        }
+    }
+
     // Organises files in the given directory into categorised subfolders
     void organise(const std::string& directory)
     {
-        if (!fs::exists(directory) || !fs::is_directory(directory))
+        if (!prepare(directory))
         {
-            std::cerr << "Invalid directory path!" << std::endl;
             return;
         }
 
-        // Iterate over each file in the directory
-        for (const auto& entry : fs::directory_iterator(directory))
+        fs::path targetRoot = m_options.targetRoot.empty() ? fs::path(directory) : fs::path(m_options.targetRoot);
+        std::vector<PlannedMove> plan;
+        try
+        {
+            plan = buildPlan(directory, targetRoot);
+        }
+        catch (const fs::filesystem_error& e)
+        {
+            std::cerr << "Error reading directory: " << e.what() << std::endl;
+            return;
+        }
+
+        if (m_options.dryRun)
+        {
+            printPlan(plan, targetRoot);
+            return;
+        }
+
+        executePlan(plan);
+
+        std::cout << "Organisation complete." << std::endl;
+    }
+
+    // Organises the directory once to catch up, then keeps it organised: inotify reports every file that
+    // is closed after writing or moved in, and the files are organised in batches. Events are coalesced
+    // into a set, so a file written several times is planned once, and a batch is run once no event has
+    // arrived for QuietPeriod, or at the latest MaxDelay after its first event. Each file therefore costs
+    // the same however many files the directory already holds. Runs until SIGINT or SIGTERM
+    void watch(const std::string& directory)
+    {
+        static constexpr std::chrono::milliseconds QuietPeriod{ 200 };
+        static constexpr std::chrono::milliseconds MaxDelay{ 2000 };
+        static constexpr size_t MaxBatch = 4096;
+
+        if (!prepare(directory))
+        {
+            return;
+        }
+
+        int inotifyFd = ::inotify_init1(IN_CLOEXEC);
+        if (inotifyFd < 0)
+        {
+            std::cerr << "Error starting inotify: " << std::strerror(errno) << std::endl;
+            return;
+        }
+
+        // Watches are in place before the catch-up scan, so nothing that lands during it is missed
+        fs::path targetRoot = m_options.targetRoot.empty() ? fs::path(directory) : fs::path(m_options.targetRoot);
+        OutputFolders skipped = skippedFolders(directory, targetRoot);
+        std::unordered_map<int, std::string> watched;          // Watch descriptor -> relative directory
+        addWatches(inotifyFd, directory, "", skipped, watched, nullptr);
+        if (watched.empty())
         {
-            if (fs::is_regular_file(entry.path()))
+            ::close(inotifyFd);
+            return;
+        }
+        int rootWatch = watched.begin()->first;
+
+        organise(directory);
+
+        struct sigaction action{};
+        action.sa_handler = [](int) { stopRequested = 1; };
+        ::sigaction(SIGINT, &action, nullptr);
+        ::sigaction(SIGTERM, &action, nullptr);
+        std::cout << "Watching " << directory << " for new files (Ctrl+C to stop)" << std::endl;
+
+        std::unordered_set<std::string> pending;               // Files with events, relative to 'directory'
+        bool rescan = false;                                    // Events were lost; the directory must be rescanned
+        auto firstEvent = std::chrono::steady_clock::now();
+        auto lastEvent = firstEvent;
+        alignas(struct inotify_event) char buffer[64 * 1024];
+
+        while (!stopRequested)
+        {
+            if (!pending.empty() || rescan)
+            {
+                auto now = std::chrono::steady_clock::now();
+                auto due = std::min(lastEvent + QuietPeriod, firstEvent + MaxDelay);
+                if (now >= due || pending.size() >= MaxBatch)
+                {
+                    if (rescan)
+                    {
+                        organise(directory);
+                    }
+                    else
+                    {
+                        organiseBatch(directory, targetRoot, pending);
+                    }
+                    pending.clear();
+                    rescan = false;
+                    continue;
+                }
+            }
+
+            int timeout = -1;
+            if (!pending.empty() || rescan)
+            {
+                auto due = std::min(lastEvent + QuietPeriod, firstEvent + MaxDelay);
+                timeout = static_cast<int>(std::max<std::chrono::milliseconds::rep>(0,
+                    std::chrono::duration_cast<std::chrono::milliseconds>(due - std::chrono::steady_clock::now()).count() + 1));
+            }
+            struct pollfd ready{ inotifyFd, POLLIN, 0 };
+            int result = ::poll(&ready, 1, timeout);
+            if (result < 0 && errno != EINTR)
+            {
+                std::cerr << "Error waiting for events: " << std::strerror(errno) << std::endl;
+                break;
+            }
+            if (result <= 0)
             {
-                std::string category = getCategory(entry.path());
-                fs::path targetDir = fs::path(directory) / category;
+                continue;
+            }
 
-                // Create target directory if it doesn't exist
-                fs::create_directories(targetDir);
+            ssize_t length = ::read(inotifyFd, buffer, sizeof(buffer));
+            if (length <= 0)
+            {
+                continue;
+            }
+            if (pending.empty() && !rescan)
+            {
+                firstEvent = std::chrono::steady_clock::now();
+            }
+            lastEvent = std::chrono::steady_clock::now();
 
-                fs::path targetPath = targetDir / entry.path().filename();
+            for (char* next = buffer; next < buffer + length;)
+            {
+                const struct inotify_event* event = reinterpret_cast<const struct inotify_event*>(next);
+                next += sizeof(struct inotify_event) + event->len;
 
-                // Move the file to its target directory
-                fs::rename(entry.path(), targetPath);
+                if (event->mask & IN_Q_OVERFLOW)
+                {
+                    rescan = true;
+                    continue;
+                }
+                auto dir = watched.find(event->wd);
+                if (dir == watched.end())
+                {
+                    continue;
+                }
+                if (event->mask & (IN_IGNORED | IN_MOVE_SELF))
+                {
+                    if (event->wd == rootWatch)
+                    {
+                        std::cerr << "Stopped watching: " << directory << " was removed or moved" << std::endl;
+                        stopRequested = 1;
+                    }
+                    else if (event->mask & IN_MOVE_SELF)
+                    {
+                        ::inotify_rm_watch(inotifyFd, event->wd);
+                    }
+                    watched.erase(dir);
+                    continue;
+                }
+                if (event->len == 0)
+                {
+                    continue;
+                }
 
-                std::cout << "Moved: " << entry.path().filename()
-                          << " -> " << category << "/" << std::endl;
+                std::string relative = dir->second.empty() ? std::string(event->name) : dir->second + "/" + event->name;
+                if (event->mask & IN_ISDIR)
+                {
+                    // A new subdirectory may already hold files by the time its watch is added
+                    if ((event->mask & (IN_CREATE | IN_MOVED_TO)) && m_options.recursive && !skipped.contains(relative))
+                    {
+                        addWatches(inotifyFd, directory, relative, skipped, watched, &pending);
+                    }
+                }
+                else if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO))
+                {
+                    pending.insert(std::move(relative));
+                }
             }
         }
 
-        std::cout << "Organisation complete." << std::endl;
+        if (!pending.empty())
+        {
+            organiseBatch(directory, targetRoot, pending);
+        }
+        ::close(inotifyFd);
+        std::cout << "Stopped watching " << directory << std::endl;
     }
 };
 
-int main()
+// Prints the command line options
+void printUsage(const char* program)
 {
+    std::cerr << "Usage: " << program << " [--dry-run|-n] [--no-sniff] [--watch|-w] [--recursive|-r] [--rules FILE]\n"
+              << "       [--target DIR] [--threads N] [DIRECTORY]" << std::endl;
+}
+
+// Parses a whole decimal count no larger than 'max'
+bool parseCount(const std::string& text, uintmax_t max, uintmax_t& value)
+{
+    if (text.empty())
+    {
+        return false;
+    }
+    value = 0;
+    for (char c : text)
+    {
+        if (!std::isdigit(static_cast<unsigned char>(c)))
+        {
+            return false;
+        }
+        uintmax_t digit = static_cast<uintmax_t>(c - '0');
+        if (value > (max - digit) / 10)
+        {
+            return false;
+        }
+        value = value * 10 + digit;
+    }
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    OrganiseOptions options;
     std::string directory;
-    std::cout << "Enter directory to organise: ";
-    std::getline(std::cin, directory);
 
-    FileOrganiser organiser;
-    organiser.organise(directory);
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--dry-run" || arg == "-n")
+        {
+            options.dryRun = true;
+        }
+        else if (arg == "--no-sniff")
+        {
+            options.sniffContent = false;
+        }
+        else if (arg == "--watch" || arg == "-w")
+        {
+            options.watch = true;
+        }
+        else if (arg == "--recursive" || arg == "-r")
+        {
+            options.recursive = true;
+        }
+        else if (arg == "--rules" && i + 1 < argc)
+        {
+            options.rulesFile = argv[++i];
+        }
+        else if (arg == "--target" && i + 1 < argc)
+        {
+            options.targetRoot = argv[++i];
+        }
+        else if (arg == "--threads" && i + 1 < argc)
+        {
+            uintmax_t threads = 0;
+            if (!parseCount(argv[++i], 1024, threads))
+            {
+                std::cerr << "Invalid value for --threads: '" << argv[i] << "'" << std::endl;
+                printUsage(argv[0]);
+                return 1;
+            }
+            options.threads = static_cast<unsigned int>(threads);
+        }
+        else
+        {
+            directory = arg;
+        }
+    }
+
+    if (directory.empty())
+    {
+        std::cout << "Enter directory to organise: ";
+        std::getline(std::cin, directory);
+    }
+
+    FileOrganiser organiser(options);
+    if (options.watch)
+    {
+        organiser.watch(directory);
+    }
+    else
+    {
+        organiser.organise(directory);
+    }
 
     return 0;
 }
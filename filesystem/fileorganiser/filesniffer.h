@@ -0,0 +1,203 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstddef>
+#include <string_view>
+
+extern "C"
+{
+    #include <fcntl.h>
+    #include <unistd.h>
+}
+
+// Signature table used by FileSniffer. Signatures are listed in priority order, more specific before
+// more general: an OOXML document is also a ZIP file.
+// Some signatures are weak evidence: a few short printable patterns turn up at the start of ordinary
+// text ("BMW ..." looks like a bitmap), and a bare ZIP or OLE container also holds documents whose
+// first entry is not the one checked here. Binary magic numbers stay strong however short they are. Weak signatures only classify files whose extension is
+// unknown; a known extension wins over them
+namespace filesignatures
+{
+    struct Pattern
+    {
+        size_t offset;
+        std::string_view bytes;
+    };
+
+    // A signature matches when its primary pattern and, if present, its secondary pattern both match
+    struct Signature
+    {
+        Pattern primary;
+        Pattern secondary;
+        std::string_view category;
+        bool container{ false };    // A generic container format, whatever the extension says it holds
+        bool weak{ false };         // A printable pattern that ordinary text can start with
+    };
+
+    constexpr bool isWeak(const Signature& signature)
+    {
+        return signature.container || signature.weak;
+    }
+
+    constexpr Signature Signatures[] =
+    {
+        // Containers whose sub-type lives further in: check them before the bare container
+        { { 0, "PK\x03\x04" }, { 30, "[Content_Types].xml" }, "Documents" },    // OOXML (docx, xlsx, pptx)
+        { { 0, "PK\x03\x04" }, { 30, "mimetypeapplication/" }, "Documents" },   // OpenDocument, EPUB
+        { { 0, "RIFF" }, { 8, "WEBP" }, "Images" },
+        { { 0, "RIFF" }, { 8, "WAVE" }, "Audio" },
+        { { 0, "RIFF" }, { 8, "AVI " }, "Videos" },
+        { { 4, "ftyp" }, { 8, "M4A " }, "Audio" },
+        { { 4, "ftyp" }, { 8, "heic" }, "Images" },
+        { { 4, "ftyp" }, { 8, "avif" }, "Images" },
+        { { 4, "ftyp" }, {}, "Videos" },                                         // MP4, MOV, 3GP
+
+        { { 0, "\xFF\xD8\xFF" }, {}, "Images" },
+        { { 0, "\x89PNG\r\n\x1A\n" }, {}, "Images" },
+        { { 0, "GIF87a" }, {}, "Images" },
+        { { 0, "GIF89a" }, {}, "Images" },
+        { { 0, std::string_view("II*\0", 4) }, {}, "Images" },                   // TIFF, little endian
+        { { 0, std::string_view("MM\0*", 4) }, {}, "Images" },                   // TIFF, big endian
+        { { 0, "BM" }, { 6, std::string_view("\0\0\0\0", 4) }, "Images", false, true }, // BMP, reserved fields zero
+
+        { { 0, "%PDF-" }, {}, "Documents" },
+        { { 0, "\xD0\xCF\x11\xE0\xA1\xB1\x1A\xE1" }, {}, "Documents", true },   // OLE: legacy Office (doc, xls), also msi, msg
+        { { 0, "{\\rtf" }, {}, "Documents" },
+
+        { { 0, "ID3" }, {}, "Audio", false, true },
+        { { 0, "\xFF\xFB" }, {}, "Audio" },                                      // MPEG audio frame sync
+        { { 0, "\xFF\xF3" }, {}, "Audio" },
+        { { 0, "\xFF\xF2" }, {}, "Audio" },
+        { { 0, "fLaC" }, {}, "Audio" },
+        { { 0, "OggS" }, {}, "Audio" },
+
+        { { 0, "\x1A\x45\xDF\xA3" }, {}, "Videos" },                             // Matroska, WebM
+
+        { { 0, "PK\x03\x04" }, {}, "Archives", true },
+        { { 0, "Rar!\x1A\x07" }, {}, "Archives" },
+        { { 0, "7z\xBC\xAF\x27\x1C" }, {}, "Archives" },
+        { { 0, "\x1F\x8B" }, {}, "Archives" },                                   // gzip
+        { { 0, "BZh" }, {}, "Archives", false, true },
+        { { 0, std::string_view("\xFD" "7zXZ\0", 6) }, {}, "Archives" },
+        { { 0, "\x28\xB5\x2F\xFD" }, {}, "Archives" },                           // zstd
+    };
+
+    constexpr size_t SignatureCount = sizeof(Signatures) / sizeof(Signatures[0]);
+    static_assert(SignatureCount <= 64, "signature candidates are tracked in a 64-bit mask");
+
+    // For every possible first byte, the set of signatures (as bits, in priority order) whose primary
+    // pattern starts with that byte. Signatures whose primary pattern is not at offset 0 are always tried
+    struct FirstByteIndex
+    {
+        std::array<uint64_t, 256> byFirstByte{};
+        uint64_t atOffset{ 0 };
+        uint64_t strong{ 0 };       // Signatures that are not weak
+    };
+
+    constexpr FirstByteIndex buildIndex()
+    {
+        FirstByteIndex index;
+        for (size_t i = 0; i < SignatureCount; ++i)
+        {
+            const Pattern& primary = Signatures[i].primary;
+            if (primary.offset == 0)
+            {
+                index.byFirstByte[static_cast<uint8_t>(primary.bytes[0])] |= uint64_t(1) << i;
+            }
+            else
+            {
+                index.atOffset |= uint64_t(1) << i;
+            }
+            if (!isWeak(Signatures[i]))
+            {
+                index.strong |= uint64_t(1) << i;
+            }
+        }
+        return index;
+    }
+
+    constexpr FirstByteIndex Index = buildIndex();
+}
+
+// FileSniffer classifies a file from its first bytes ("magic numbers") instead of its name. The
+// signature table is indexed at compile time by the first byte of each signature, so a lookup only
+// compares the few signatures that can start with the file's first byte
+class FileSniffer
+{
+public:
+    static constexpr size_t HeaderSize = 64;
+
+    // Reads the first HeaderSize bytes of 'filepath' and returns the matching category, or an empty
+    // view if no signature matches or the file cannot be read. With 'knownExtension' only strong
+    // signatures are tried, so the extension decides unless the content clearly says otherwise
+    static std::string_view classify(const char* filepath, bool knownExtension = false)
+    {
+        // O_NOATIME spares an inode write per file, but is only allowed on files we own
+        int fd = ::open(filepath, O_RDONLY | O_CLOEXEC | O_NOATIME);
+        if (fd < 0)
+        {
+            fd = ::open(filepath, O_RDONLY | O_CLOEXEC);
+            if (fd < 0)
+            {
+                return {};
+            }
+        }
+        uint8_t header[HeaderSize];
+        ssize_t length = ::pread(fd, header, sizeof(header), 0);
+        ::close(fd);
+        return length > 0 ? match(header, static_cast<size_t>(length), knownExtension) : std::string_view();
+    }
+
+    // Matches an in-memory header against the signature table
+    static std::string_view match(const uint8_t* header, size_t length, bool knownExtension = false)
+    {
+        uint64_t candidates = filesignatures::Index.byFirstByte[header[0]] | filesignatures::Index.atOffset;
+        if (knownExtension)
+        {
+            candidates &= filesignatures::Index.strong;
+        }
+        while (candidates)
+        {
+            size_t i = static_cast<size_t>(__builtin_ctzll(candidates));
+            candidates &= candidates - 1;
+            const filesignatures::Signature& signature = filesignatures::Signatures[i];
+            if (matches(signature.primary, header, length) &&
+                (signature.secondary.bytes.empty() || matches(signature.secondary, header, length)))
+            {
+                return signature.category;
+            }
+        }
+        return {};
+    }
+
+    // True when 'name' is a category some signature reports
+    static bool isCategory(std::string_view name)
+    {
+        for (const auto& signature : filesignatures::Signatures)
+        {
+            if (signature.category == name)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    static bool matches(const filesignatures::Pattern& pattern, const uint8_t* header, size_t length)
+    {
+        if (pattern.offset + pattern.bytes.size() > length)
+        {
+            return false;
+        }
+        for (size_t i = 0; i < pattern.bytes.size(); ++i)
+        {
+            if (header[pattern.offset + i] != static_cast<uint8_t>(pattern.bytes[i]))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+};
@@ -0,0 +1,561 @@
+#pragma once
+
+#include <algorithm>
+#include <bitset>
+#include <cctype>
+#include <cstdint>
+#include <ctime>
+#include <fstream>
+#include <istream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "filesniffer.h"
+
+// GlobPattern is a shell-style wildcard compiled once into a token sequence: literal runs, '?', '*'
+// and character classes such as [a-z] or [!0-9]. Matching walks the tokens iteratively, backtracking
+// only to the most recent '*', so it never recurses and runs in linear time for typical patterns.
+// A pattern that ends in a literal (e.g. "*.tar.gz") is rejected by a suffix test before any matching
+class GlobPattern
+{
+public:
+    explicit GlobPattern(const std::string& pattern) : m_matchesPath(pattern.find('/') != std::string::npos)
+    {
+        for (size_t i = 0; i < pattern.size(); ++i)
+        {
+            char c = pattern[i];
+            if (c == '*')
+            {
+                if (m_tokens.empty() || m_tokens.back().type != TokenType::AnySequence)
+                    m_tokens.push_back({ TokenType::AnySequence, {}, {} });
+            }
+            else if (c == '?')
+            {
+                m_tokens.push_back({ TokenType::AnyChar, {}, {} });
+            }
+            else if (c == '[' && pattern.find(']', i + 2) != std::string::npos)
+            {
+                i = parseClass(pattern, i + 1);
+            }
+            else
+            {
+                if (c == '\\' && i + 1 < pattern.size())
+                    c = pattern[++i];
+                if (m_tokens.empty() || m_tokens.back().type != TokenType::Literal)
+                    m_tokens.push_back({ TokenType::Literal, {}, {} });
+                m_tokens.back().text += c;
+            }
+        }
+        if (!m_tokens.empty() && m_tokens.back().type == TokenType::Literal)
+        {
+            m_requiredSuffix = m_tokens.back().text;
+        }
+    }
+
+    // Patterns containing '/' are matched against the path relative to the organised directory,
+    // others against the file name only
+    bool matchesPath() const
+    {
+        return m_matchesPath;
+    }
+
+    bool matches(std::string_view text) const
+    {
+        if (text.size() < m_requiredSuffix.size() ||
+            text.compare(text.size() - m_requiredSuffix.size(), m_requiredSuffix.size(), m_requiredSuffix) != 0)
+        {
+            return false;
+        }
+
+        constexpr size_t None = SIZE_MAX;
+        size_t token = 0;
+        size_t pos = 0;
+        size_t starToken = None;
+        size_t starPos = 0;
+        while (pos < text.size())
+        {
+            if (token < m_tokens.size())
+            {
+                const Token& current = m_tokens[token];
+                if (current.type == TokenType::AnySequence)
+                {
+                    starToken = token++;
+                    starPos = pos;
+                    continue;
+                }
+                if (current.type == TokenType::Literal && text.compare(pos, current.text.size(), current.text) == 0)
+                {
+                    pos += current.text.size();
+                    ++token;
+                    continue;
+                }
+                if (current.type == TokenType::AnyChar ||
+                    (current.type == TokenType::Class && current.set[static_cast<unsigned char>(text[pos])]))
+                {
+                    ++pos;
+                    ++token;
+                    continue;
+                }
+            }
+            if (starToken == None)
+            {
+                return false;
+            }
+            // Let the last '*' swallow one more character and retry from there
+            token = starToken + 1;
+            pos = ++starPos;
+        }
+        while (token < m_tokens.size() && m_tokens[token].type == TokenType::AnySequence)
+        {
+            ++token;
+        }
+        return token == m_tokens.size();
+    }
+
+private:
+    enum class TokenType { Literal, AnyChar, AnySequence, Class };
+
+    struct Token
+    {
+        TokenType type;
+        std::string text;           // Literal characters
+        std::bitset<256> set;       // Accepted bytes of a character class
+    };
+
+    std::vector<Token> m_tokens;
+    std::string m_requiredSuffix;
+    bool m_matchesPath;
+
+    // Parses the body of a character class starting at 'i' and returns the index of its closing ']'
+    size_t parseClass(const std::string& pattern, size_t i)
+    {
+        Token token{ TokenType::Class, {}, {} };
+        bool negated = pattern[i] == '!' || pattern[i] == '^';
+        if (negated)
+            ++i;
+        for (bool first = true; i < pattern.size() && (first || pattern[i] != ']'); ++i, first = false)
+        {
+            unsigned char low = static_cast<unsigned char>(pattern[i]);
+            unsigned char high = low;
+            if (i + 2 < pattern.size() && pattern[i + 1] == '-' && pattern[i + 2] != ']')
+            {
+                high = static_cast<unsigned char>(pattern[i + 2]);
+                i += 2;
+            }
+            for (unsigned int c = low; c <= high; ++c)
+            {
+                token.set.set(c);
+            }
+        }
+        if (negated)
+        {
+            token.set.flip();
+        }
+        m_tokens.push_back(std::move(token));
+        return i;
+    }
+};
+
+// RuleSet decides where a file goes. Rules are read from a text file, one per line, and the first
+// matching rule wins:
+//
+//     # matcher [values...] [min SIZE] [max SIZE] -> target folder
+//     type *                  -> {type}
+//     ext jpg jpeg png        -> Images/{year}/{month}
+//     glob invoice_*.pdf      -> Documents/Invoices/{year}
+//     ext mp4 mkv min 1G      -> Videos/Large
+//     any                     -> Others
+//
+// Matchers are 'ext' (case-insensitive extensions), 'glob' (wildcards), 'type' (the category found by
+// FileSniffer, '*' for any recognised type) and 'any'. A file whose extension has an 'ext' rule is
+// only sniffed for strong signatures (see filesniffer.h). Targets may use {year}, {month} and {day}
+// of the modification time, {type} and {ext}.
+// The rules are compiled once: extension rules are indexed in a hash table by extension, so a file
+// only visits the rules for its own extension plus the rules that do not depend on it, in rule order
+class RuleSet
+{
+public:
+    // What a rule may look at. 'path' must be NUL-terminated, since 'type' rules open the file
+    struct File
+    {
+        const std::string& path;
+        std::string_view relativePath;
+        std::string_view name;
+        uintmax_t size;
+        int64_t mtime;
+    };
+
+    // Parses rules from a stream, replacing any loaded before. On failure 'error' names the line
+    bool parse(std::istream& in, std::string& error)
+    {
+        m_rules.clear();
+        m_globs.clear();
+        m_byExtension.clear();
+        m_general.clear();
+        m_needsStat = false;
+
+        std::string line;
+        for (size_t lineNumber = 1; std::getline(in, line); ++lineNumber)
+        {
+            line = line.substr(0, line.find('#'));
+            std::istringstream words(line);
+            std::vector<std::string> tokens;
+            for (std::string word; words >> word;)
+            {
+                tokens.push_back(word);
+            }
+            if (tokens.empty())
+            {
+                continue;
+            }
+            if (!parseRule(tokens, error))
+            {
+                error = "line " + std::to_string(lineNumber) + ": " + error;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool load(const std::string& filepath, std::string& error)
+    {
+        std::ifstream in(filepath);
+        if (!in)
+        {
+            error = "cannot open " + filepath;
+            return false;
+        }
+        return parse(in, error);
+    }
+
+    // True when a rule needs the file's size or modification time
+    bool needsStat() const
+    {
+        return m_needsStat;
+    }
+
+    // True when some rule writes into a folder called 'name' directly under the target root: the
+    // first component of a target, e.g. "Images" for "Images/{year}". Placeholders match what they
+    // can expand to, so "2024" is an output folder of "{year}/{month}" and "Audio" of "{type}"
+    bool isOutputFolder(std::string_view name) const
+    {
+        return std::any_of(m_rules.begin(), m_rules.end(), [name](const Rule& rule)
+        {
+            return matchesTemplate(std::string_view(rule.target).substr(0, rule.target.find('/')), name);
+        });
+    }
+
+    // Returns the target folder for a file, relative to the target root, or an empty string if no
+    // rule matches. 'sniff' allows 'type' rules and {type} to read the file header
+    std::string evaluate(const File& file, bool sniff) const
+    {
+        std::string ext = extensionOf(file.name);
+        static const std::vector<uint32_t> none;
+        auto it = m_byExtension.find(ext);
+        const std::vector<uint32_t>& byExtension = it == m_byExtension.end() ? none : it->second;
+
+        // The file header is read at most once, and only if a rule needs it
+        bool sniffed = false;
+        std::string_view type;
+        auto fileType = [&]()
+        {
+            if (!sniffed && sniff)
+            {
+                type = FileSniffer::classify(file.path.c_str(), !byExtension.empty());
+            }
+            sniffed = true;
+            return type;
+        };
+
+        // Both candidate lists are sorted, so merging them visits the rules in file order
+        size_t a = 0;
+        size_t b = 0;
+        while (a < byExtension.size() || b < m_general.size())
+        {
+            bool takeA = b == m_general.size() || (a < byExtension.size() && byExtension[a] < m_general[b]);
+            const Rule& rule = m_rules[takeA ? byExtension[a++] : m_general[b++]];
+            if (file.size < rule.minSize || file.size > rule.maxSize)
+            {
+                continue;
+            }
+            bool matched = false;
+            switch (rule.kind)
+            {
+            case Kind::Extension:
+            case Kind::Any:
+                matched = true;
+                break;
+            case Kind::Glob:
+                for (size_t glob : rule.globs)
+                {
+                    const GlobPattern& pattern = m_globs[glob];
+                    if (pattern.matches(pattern.matchesPath() ? file.relativePath : file.name))
+                    {
+                        matched = true;
+                        break;
+                    }
+                }
+                break;
+            case Kind::Type:
+                if (!fileType().empty())
+                {
+                    matched = std::any_of(rule.values.begin(), rule.values.end(), [&](const std::string& value)
+                    {
+                        return value == "*" || value == fileType();
+                    });
+                }
+                break;
+            }
+            if (matched)
+            {
+                return expand(rule.target, file, ext, fileType);
+            }
+        }
+        return std::string();
+    }
+
+private:
+    enum class Kind { Extension, Glob, Type, Any };
+
+    struct Rule
+    {
+        Kind kind;
+        std::vector<std::string> values;
+        std::vector<size_t> globs;          // Indices into m_globs
+        uintmax_t minSize{ 0 };
+        uintmax_t maxSize{ UINTMAX_MAX };
+        std::string target;
+    };
+
+    std::vector<Rule> m_rules;
+    std::vector<GlobPattern> m_globs;
+    std::unordered_map<std::string, std::vector<uint32_t>> m_byExtension;
+    std::vector<uint32_t> m_general;        // Rules tried for every file, in rule order
+    bool m_needsStat{ false };
+
+    static std::string extensionOf(std::string_view name)
+    {
+        size_t dot = name.rfind('.');
+        if (dot == std::string_view::npos || dot == 0)
+        {
+            return std::string();
+        }
+        std::string ext(name.substr(dot + 1));
+        std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        return ext;
+    }
+
+    // Parses a byte count with an optional K, M, G or T suffix (powers of 1024). Only digits are
+    // accepted before the suffix, and a value that would not fit is rejected rather than wrapped
+    static bool parseSize(const std::string& text, uintmax_t& value)
+    {
+        size_t end = 0;
+        value = 0;
+        for (; end < text.size() && std::isdigit(static_cast<unsigned char>(text[end])); ++end)
+        {
+            uintmax_t digit = static_cast<uintmax_t>(text[end] - '0');
+            if (value > (UINTMAX_MAX - digit) / 10)
+            {
+                return false;
+            }
+            value = value * 10 + digit;
+        }
+        if (end == 0)
+        {
+            return false;
+        }
+        if (end == text.size())
+        {
+            return true;
+        }
+        static const std::string units = "KMGT";
+        size_t exponent = units.find(static_cast<char>(std::toupper(static_cast<unsigned char>(text[end]))));
+        if (exponent == std::string::npos || end + 1 != text.size())
+        {
+            return false;
+        }
+        unsigned int shift = static_cast<unsigned int>(10 * (exponent + 1));
+        if (value > (UINTMAX_MAX >> shift))
+        {
+            return false;
+        }
+        value <<= shift;
+        return true;
+    }
+
+    bool parseRule(const std::vector<std::string>& tokens, std::string& error)
+    {
+        auto arrow = std::find(tokens.begin(), tokens.end(), "->");
+        if (arrow == tokens.end() || arrow + 2 != tokens.end())
+        {
+            error = "expected '-> target' at the end of the rule";
+            return false;
+        }
+
+        Rule rule;
+        const std::string& matcher = tokens[0];
+        if (matcher == "ext")
+            rule.kind = Kind::Extension;
+        else if (matcher == "glob")
+            rule.kind = Kind::Glob;
+        else if (matcher == "type")
+            rule.kind = Kind::Type;
+        else if (matcher == "any")
+            rule.kind = Kind::Any;
+        else
+        {
+            error = "unknown matcher '" + matcher + "'";
+            return false;
+        }
+
+        for (auto it = tokens.begin() + 1; it != arrow; ++it)
+        {
+            if ((*it == "min" || *it == "max") && it + 1 != arrow)
+            {
+                uintmax_t& bound = *it == "min" ? rule.minSize : rule.maxSize;
+                if (!parseSize(*++it, bound))
+                {
+                    error = "invalid size '" + *it + "'";
+                    return false;
+                }
+                m_needsStat = true;
+            }
+            else if (rule.kind == Kind::Glob)
+            {
+                rule.globs.push_back(m_globs.size());
+                m_globs.emplace_back(*it);
+            }
+            else
+            {
+                rule.values.push_back(*it);
+            }
+        }
+        if (rule.kind != Kind::Any && rule.values.empty() && rule.globs.empty())
+        {
+            error = "'" + matcher + "' needs at least one value";
+            return false;
+        }
+
+        rule.target = *(arrow + 1);
+        if (rule.target.find("{year}") != std::string::npos || rule.target.find("{month}") != std::string::npos ||
+            rule.target.find("{day}") != std::string::npos)
+        {
+            m_needsStat = true;
+        }
+
+        uint32_t index = static_cast<uint32_t>(m_rules.size());
+        if (rule.kind == Kind::Extension)
+        {
+            for (auto& value : rule.values)
+            {
+                std::string ext = value[0] == '.' ? value.substr(1) : value;
+                std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+                std::vector<uint32_t>& rules = m_byExtension[ext];
+                if (rules.empty() || rules.back() != index)
+                {
+                    rules.push_back(index);
+                }
+            }
+        }
+        else
+        {
+            m_general.push_back(index);
+        }
+        m_rules.push_back(std::move(rule));
+        return true;
+    }
+
+    // Matches a folder name against a target component with placeholders, trying every length each
+    // placeholder could take. Components have few placeholders, so the backtracking stays small
+    static bool matchesTemplate(std::string_view pattern, std::string_view name)
+    {
+        size_t open = pattern.find('{');
+        size_t close = open == std::string_view::npos ? std::string_view::npos : pattern.find('}', open);
+        if (close == std::string_view::npos)
+        {
+            return pattern == name;
+        }
+        std::string_view literal = pattern.substr(0, open);
+        if (name.substr(0, literal.size()) != literal)
+        {
+            return false;
+        }
+        name.remove_prefix(literal.size());
+        std::string_view placeholder = pattern.substr(open, close - open + 1);
+        std::string_view rest = pattern.substr(close + 1);
+        for (size_t length = 1; length <= name.size(); ++length)
+        {
+            if (placeholderMatches(placeholder, name.substr(0, length)) && matchesTemplate(rest, name.substr(length)))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Whether expand() can turn 'placeholder' (with braces) into 'value'
+    static bool placeholderMatches(std::string_view placeholder, std::string_view value)
+    {
+        auto digits = [value](size_t count)
+        {
+            return value.size() == count &&
+                   std::all_of(value.begin(), value.end(), [](unsigned char c) { return std::isdigit(c) != 0; });
+        };
+        if (placeholder == "{year}")
+            return digits(4);
+        if (placeholder == "{month}" || placeholder == "{day}")
+            return digits(2);
+        if (placeholder == "{ext}")
+            return value.find('.') == std::string_view::npos &&
+                   std::none_of(value.begin(), value.end(), [](unsigned char c) { return std::isupper(c) != 0; });
+        if (placeholder == "{type}")
+            return value == "Others" || FileSniffer::isCategory(value);
+        return value == placeholder;        // Unknown placeholders are kept as they are
+    }
+
+    // Substitutes the placeholders of a target folder
+    template <typename TypeLookup>
+    static std::string expand(const std::string& target, const File& file, const std::string& ext, TypeLookup& fileType)
+    {
+        if (target.find('{') == std::string::npos)
+        {
+            return target;
+        }
+
+        std::tm local{};
+        time_t mtime = static_cast<time_t>(file.mtime);
+        localtime_r(&mtime, &local);
+        char year[16], month[8], day[8];
+        std::strftime(year, sizeof(year), "%Y", &local);
+        std::strftime(month, sizeof(month), "%m", &local);
+        std::strftime(day, sizeof(day), "%d", &local);
+
+        std::string result;
+        for (size_t i = 0; i < target.size(); ++i)
+        {
+            size_t close = target[i] == '{' ? target.find('}', i) : std::string::npos;
+            if (close == std::string::npos)
+            {
+                result += target[i];
+                continue;
+            }
+            std::string name = target.substr(i + 1, close - i - 1);
+            if (name == "year")
+                result += year;
+            else if (name == "month")
+                result += month;
+            else if (name == "day")
+                result += day;
+            else if (name == "ext")
+                result += ext.empty() ? "none" : ext;
+            else if (name == "type")
+                result += fileType().empty() ? std::string("Others") : std::string(fileType());
+            else
+                result += target.substr(i, close - i + 1);
+            i = close;
+        }
+        return result;
+    }
+};
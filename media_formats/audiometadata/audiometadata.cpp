@@ -0,0 +1,122 @@
+#include "audiometadata.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <filesystem>
+#include <iostream>
+#include <thread>
+#include <taglib/fileref.h>
+#include <taglib/tag.h>
+#include <taglib/audioproperties.h>
+
+namespace fs = std::filesystem;
+
+namespace audiometadata
+{
+    bool isAudioFile(const std::string& filepath)
+    {
+        std::string ext = fs::path(filepath).extension().string();
+        std::transform(ext.begin(), ext.end(), ext.begin(),
+                       [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        return ext == ".mp3" || ext == ".wav" || ext == ".flac" || ext == ".ogg" || ext == ".opus"
+            || ext == ".m4a" || ext == ".aiff" || ext == ".wma";
+    }
+
+    std::vector<std::string> collectAudioFiles(const std::string& directory, bool recursive)
+    {
+        std::vector<std::string> files;
+        std::error_code ec;
+
+        if (recursive)
+        {
+            fs::recursive_directory_iterator it(directory, fs::directory_options::skip_permission_denied, ec);
+            for (; !ec && it != fs::recursive_directory_iterator(); it.increment(ec))
+            {
+                if (it->is_regular_file(ec) && isAudioFile(it->path().string()))
+                {
+                    files.push_back(it->path().string());
+                }
+            }
+        }
+        else
+        {
+            fs::directory_iterator it(directory, fs::directory_options::skip_permission_denied, ec);
+            for (; !ec && it != fs::directory_iterator(); it.increment(ec))
+            {
+                if (it->is_regular_file(ec) && isAudioFile(it->path().string()))
+                {
+                    files.push_back(it->path().string());
+                }
+            }
+        }
+
+        if (ec)
+        {
+            std::cerr << "Error scanning " << directory << ": " << ec.message() << "\n";
+        }
+        return files;
+    }
+
+    AudioMetadata extract(const std::string& filepath, LengthAccuracy accuracy)
+    {
+        AudioMetadata meta;
+        meta.filepath = filepath;
+
+        TagLib::FileRef file(filepath.c_str(), true,
+                             accuracy == LengthAccuracy::Fast ? TagLib::AudioProperties::Fast : TagLib::AudioProperties::Average);
+        if (!file.isNull() && file.tag() && file.audioProperties())
+        {
+            auto* tag = file.tag();
+            auto* properties = file.audioProperties();
+
+            meta.artist = tag->artist().to8Bit(true);
+            meta.album = tag->album().to8Bit(true);
+            meta.title = tag->title().to8Bit(true);
+            meta.year = tag->year();
+            meta.durationSeconds = properties->lengthInSeconds();
+            meta.valid = true;
+        }
+        return meta;
+    }
+
+    std::vector<AudioMetadata> extractAll(const std::vector<std::string>& filepaths, unsigned int numThreads, LengthAccuracy accuracy)
+    {
+        std::vector<AudioMetadata> results(filepaths.size());
+        if (filepaths.empty())
+        {
+            return results;
+        }
+
+        if (numThreads == 0)
+        {
+            numThreads = std::thread::hardware_concurrency();
+            if (numThreads == 0)
+                numThreads = 2;
+        }
+        numThreads = static_cast<unsigned int>(std::min<size_t>(numThreads, filepaths.size()));
+
+        // Each worker claims the next unprocessed index, so slow files don't stall a fixed partition.
+        // Every slot of 'results' is written by exactly one worker, which means no locking is required
+        std::atomic<size_t> nextIndex{ 0 };
+        auto worker = [&]()
+        {
+            for (size_t i = nextIndex++; i < filepaths.size(); i = nextIndex++)
+            {
+                results[i] = extract(filepaths[i], accuracy);
+            }
+        };
+
+        std::vector<std::thread> pool;
+        pool.reserve(numThreads);
+        for (unsigned int t = 0; t < numThreads; ++t)
+        {
+            pool.emplace_back(worker);
+        }
+        for (auto& t : pool)
+        {
+            t.join();
+        }
+        return results;
+    }
+}
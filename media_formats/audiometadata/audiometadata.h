@@ -0,0 +1,57 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <iterator>
+
+// AudioMetadata holds the typed metadata extracted from a single audio file
+struct AudioMetadata
+{
+    std::string filepath;       // Path of the source file
+    std::string artist;         // Artist tag
+    std::string album;          // Album tag
+    std::string title;          // Title tag
+    unsigned int year{ 0 };     // Release year (0 when missing)
+    int durationSeconds{ 0 };   // Track length in seconds
+    bool valid{ false };        // False when TagLib could not read the file
+};
+
+namespace audiometadata
+{
+    // How TagLib reads the audio properties. Average (TagLib's default) is accurate enough for most
+    // files; Fast skips work such as reading MP3 frames when there is no Xing or VBRI header, so the
+    // duration of variable bitrate files without one can be far off
+    enum class LengthAccuracy
+    {
+        Average,
+        Fast
+    };
+
+    // Returns true when the extension belongs to a supported audio format (case-insensitive)
+    bool isAudioFile(const std::string& filepath);
+
+    // Collects the audio files under a directory, optionally descending into subdirectories.
+    // Unreadable entries are skipped instead of aborting the whole scan
+    std::vector<std::string> collectAudioFiles(const std::string& directory, bool recursive = true);
+
+    // Extracts the metadata of a single file using TagLib
+    AudioMetadata extract(const std::string& filepath, LengthAccuracy accuracy = LengthAccuracy::Average);
+
+    // Extracts the metadata of every file in parallel on a pool of worker threads.
+    // Results keep the order of the input; numThreads == 0 uses the hardware concurrency
+    std::vector<AudioMetadata> extractAll(const std::vector<std::string>& filepaths, unsigned int numThreads = 0,
+                                          LengthAccuracy accuracy = LengthAccuracy::Average);
+
+    // Convenience overload accepting any range of path-like values
+    template <typename Range>
+    std::vector<AudioMetadata> extractAll(const Range& range, unsigned int numThreads = 0,
+                                          LengthAccuracy accuracy = LengthAccuracy::Average)
+    {
+        std::vector<std::string> filepaths;
+        for (const auto& item : range)
+        {
+            filepaths.emplace_back(std::string(item));
+        }
+        return extractAll(filepaths, numThreads, accuracy);
+    }
+}
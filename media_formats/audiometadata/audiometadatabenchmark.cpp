@@ -0,0 +1,53 @@
+#include <iostream>
+#include <chrono>
+#include <thread>
+#include <string>
+#include <vector>
+#include "audiometadata.h"
+
+// Measures audiometadata::extractAll throughput for increasing thread counts on a real audio directory.
+// Run it twice in a row to compare a cold page cache against a warm one
+int main(int argc, char* argv[])
+{
+    std::string directory;
+    if (argc > 1)
+    {
+        directory = argv[1];
+    }
+    else
+    {
+        std::cout << "Enter the directory containing audio files: ";
+        std::getline(std::cin, directory);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::string> files = audiometadata::collectAudioFiles(directory, true);
+    auto scanMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Collected " << files.size() << " audio files in " << scanMs << " ms\n";
+    if (files.empty())
+    {
+        return 0;
+    }
+
+    unsigned int maxThreads = std::thread::hardware_concurrency();
+    if (maxThreads == 0)
+        maxThreads = 2;
+
+    for (unsigned int threads = 1; threads <= maxThreads; threads *= 2)
+    {
+        start = std::chrono::steady_clock::now();
+        std::vector<AudioMetadata> results = audiometadata::extractAll(files, threads);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        size_t valid = 0;
+        for (const auto& meta : results)
+        {
+            valid += meta.valid ? 1 : 0;
+        }
+        std::cout << "Threads: " << threads
+                  << "  Files/s: " << static_cast<size_t>(results.size() / seconds)
+                  << "  Valid: " << valid << "/" << results.size() << "\n";
+    }
+
+    return 0;
+}
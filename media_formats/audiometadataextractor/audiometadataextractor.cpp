@@ -1,51 +1,42 @@
 #include <iostream>
-#include <filesystem>
-#include <taglib/fileref.h>
-#include <taglib/tag.h>
-#include <taglib/tpropertymap.h>
-#include <taglib/audioproperties.h>
 #include <string>
+#include <vector>
+#include "../audiometadata/audiometadata.h"
 
-namespace fs = std::filesystem;
-
-// AudioMetadataExtractor class scans a directory and extracts metadata from audio files using TagLib
+// AudioMetadataExtractor class scans a directory and extracts metadata from audio files
+// using the shared audiometadata library
 class AudioMetadataExtractor
 {
 public:
-    // Scans the given directory (non-recursively) and processes each regular file
+    // Recursively scans the given directory and extracts the metadata of every audio file in parallel
     void scanDirectory(const std::string& path)
     {
-        for (const auto& entry : fs::directory_iterator(path))
+        std::vector<std::string> files = audiometadata::collectAudioFiles(path, true);
+        std::vector<AudioMetadata> results = audiometadata::extractAll(files);
+
+        for (const auto& meta : results)
         {
-            if (fs::is_regular_file(entry))
-            {
-                processFile(entry.path().string());
-            }
+            printMetadata(meta);
         }
     }
 
 private:
-    // Processes a single file: extracts and prints audio metadata
-    void processFile(const std::string& filepath)
+    // Prints the metadata of a single file, or an error if it could not be read
+    void printMetadata(const AudioMetadata& meta)
     {
-        TagLib::FileRef file(filepath.c_str());
-        if (!file.isNull() && file.tag() && file.audioProperties())
+        if (meta.valid)
         {
-            // Retrieve tag and audio properties pointers
-            auto* tag = file.tag();
-            auto* properties = file.audioProperties();
-
-            std::cout << "File: " << filepath << "\n";
-            std::cout << "Artist: " << tag->artist().to8Bit(true) << "\n";
-            std::cout << "Album: " << tag->album().to8Bit(true) << "\n";
-            std::cout << "Title: " << tag->title().to8Bit(true) << "\n";
-            std::cout << "Year: " << tag->year() << "\n";
-            std::cout << "Duration: " << properties->lengthInSeconds() << " sec\n";
+            std::cout << "File: " << meta.filepath << "\n";
+            std::cout << "Artist: " << meta.artist << "\n";
+            std::cout << "Album: " << meta.album << "\n";
+            std::cout << "Title: " << meta.title << "\n";
+            std::cout << "Year: " << meta.year << "\n";
+            std::cout << "Duration: " << meta.durationSeconds << " sec\n";
             std::cout << "---------------------------------------\n";
         }
         else
         {
-            std::cerr << "Error: Could not read metadata for " << filepath << "\n";
+            std::cerr << "Error: Could not read metadata for " << meta.filepath << "\n";
         }
     }
 };
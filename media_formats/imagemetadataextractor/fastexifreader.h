@@ -0,0 +1,458 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+extern "C"
+{
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+}
+
+// ImageSummary holds the small set of tags needed to catalogue a photo
+struct ImageSummary
+{
+    std::string filepath;           // Path of the source file
+    std::string dateTime;           // Capture time (DateTimeOriginal, falling back to DateTime)
+    std::string make;               // Camera manufacturer
+    std::string model;              // Camera model
+    uint32_t width{ 0 };            // Pixel width
+    uint32_t height{ 0 };           // Pixel height
+    uint16_t orientation{ 0 };      // EXIF orientation (1-8, 0 when missing)
+    bool hasGps{ false };           // True when latitude and longitude were found
+    double latitude{ 0.0 };         // Signed decimal degrees
+    double longitude{ 0.0 };        // Signed decimal degrees
+    double altitude{ 0.0 };         // Metres, negative below sea level
+    std::vector<uint8_t> thumbnail; // Embedded EXIF (IFD1) JPEG thumbnail, only filled on request
+};
+
+// FastExifReader memory-maps a JPEG or TIFF file and walks the APP1 segment and the TIFF IFDs
+// directly, decoding only the tags stored in ImageSummary. Nothing else (XMP, IPTC, maker notes)
+// is parsed or allocated. read() returns false for formats or layouts it does not understand,
+// so the caller can fall back to Exiv2. The embedded thumbnail is copied out only when 'withThumbnail' is set
+class FastExifReader
+{
+public:
+    static bool read(const std::string& filepath, ImageSummary& summary, bool withThumbnail = false)
+    {
+        MappedFile file(filepath);
+        if (!file.data || file.size < 4)
+        {
+            return false;
+        }
+
+        summary.filepath = filepath;
+        const uint8_t* data = file.data;
+
+        if (data[0] == 0xFF && data[1] == 0xD8)
+        {
+            return readJpeg(data, file.size, summary, withThumbnail);
+        }
+        if ((data[0] == 'I' && data[1] == 'I') || (data[0] == 'M' && data[1] == 'M'))
+        {
+            // Plain TIFF files carry their dimensions in IFD0
+            return readTiff(data, file.size, summary, true, withThumbnail);
+        }
+        return false;
+    }
+
+private:
+    // RAII wrapper around a read-only private mapping of a whole file
+    struct MappedFile
+    {
+        const uint8_t* data{ nullptr };
+        size_t size{ 0 };
+
+        explicit MappedFile(const std::string& filepath)
+        {
+            int fd = ::open(filepath.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd < 0)
+            {
+                return;
+            }
+            struct stat st;
+            if (::fstat(fd, &st) == 0 && st.st_size > 0)
+            {
+                void* ptr = ::mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+                if (ptr != MAP_FAILED)
+                {
+                    data = static_cast<const uint8_t*>(ptr);
+                    size = static_cast<size_t>(st.st_size);
+                }
+            }
+            ::close(fd);
+        }
+
+        ~MappedFile()
+        {
+            if (data)
+            {
+                ::munmap(const_cast<uint8_t*>(data), size);
+            }
+        }
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+    };
+
+    // Bounds-checked view of the TIFF structure embedded in the file
+    struct TiffView
+    {
+        const uint8_t* base;
+        size_t size;
+        bool littleEndian;
+
+        uint16_t u16(size_t offset) const
+        {
+            return littleEndian ? static_cast<uint16_t>(base[offset] | (base[offset + 1] << 8))
+                                : static_cast<uint16_t>((base[offset] << 8) | base[offset + 1]);
+        }
+
+        uint32_t u32(size_t offset) const
+        {
+            return littleEndian
+                ? static_cast<uint32_t>(base[offset]) | (static_cast<uint32_t>(base[offset + 1]) << 8)
+                    | (static_cast<uint32_t>(base[offset + 2]) << 16) | (static_cast<uint32_t>(base[offset + 3]) << 24)
+                : (static_cast<uint32_t>(base[offset]) << 24) | (static_cast<uint32_t>(base[offset + 1]) << 16)
+                    | (static_cast<uint32_t>(base[offset + 2]) << 8) | static_cast<uint32_t>(base[offset + 3]);
+        }
+    };
+
+    // A single 12-byte IFD entry
+    struct IfdEntry
+    {
+        uint16_t tag;
+        uint16_t type;
+        uint32_t count;
+        size_t valueOffset;     // Offset of the value, inline or out-of-line, inside the TIFF view
+    };
+
+    enum : uint16_t
+    {
+        TypeByte = 1, TypeAscii = 2, TypeShort = 3, TypeLong = 4, TypeRational = 5
+    };
+
+    static size_t typeSize(uint16_t type)
+    {
+        switch (type)
+        {
+            case TypeByte:
+            case TypeAscii:
+                return 1;
+            case TypeShort:
+                return 2;
+            case TypeLong:
+                return 4;
+            case TypeRational:
+                return 8;
+            default:
+                return 0;
+        }
+    }
+
+    // Walks the JPEG markers up to the start of scan, collecting the frame size and the EXIF block
+    static bool readJpeg(const uint8_t* data, size_t size, ImageSummary& summary, bool withThumbnail)
+    {
+        size_t pos = 2;
+        bool haveFrame = false;
+        uint32_t exifWidth = 0;
+        uint32_t exifHeight = 0;
+
+        while (pos + 4 <= size)
+        {
+            if (data[pos] != 0xFF)
+            {
+                return false;
+            }
+            uint8_t marker = data[pos + 1];
+            if (marker == 0xFF)
+            {
+                ++pos;      // Fill byte
+                continue;
+            }
+            if (marker == 0xD9 || marker == 0xDA)
+            {
+                break;      // End of image or start of scan: no more metadata segments
+            }
+            if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD7))
+            {
+                pos += 2;   // Stand-alone markers have no length field
+                continue;
+            }
+
+            size_t length = (static_cast<size_t>(data[pos + 2]) << 8) | data[pos + 3];
+            size_t segment = pos + 4;
+            if (length < 2 || pos + 2 + length > size)
+            {
+                return false;
+            }
+
+            bool isFrame = marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC;
+            if (isFrame && length >= 7)
+            {
+                summary.height = (static_cast<uint32_t>(data[segment + 1]) << 8) | data[segment + 2];
+                summary.width = (static_cast<uint32_t>(data[segment + 3]) << 8) | data[segment + 4];
+                haveFrame = true;
+            }
+            else if (marker == 0xE1 && length >= 8 && std::memcmp(data + segment, "Exif\0\0", 6) == 0)
+            {
+                ImageSummary exif;
+                if (readTiff(data + segment + 6, length - 8, exif, false, withThumbnail))
+                {
+                    exifWidth = exif.width;
+                    exifHeight = exif.height;
+                    exif.width = summary.width;
+                    exif.height = summary.height;
+                    exif.filepath = std::move(summary.filepath);
+                    summary = std::move(exif);
+                }
+            }
+
+            if (haveFrame)
+            {
+                break;      // APPn segments precede the frame header, so everything needed has been seen
+            }
+            pos += 2 + length;
+        }
+
+        if (!haveFrame)
+        {
+            summary.width = exifWidth;
+            summary.height = exifHeight;
+        }
+        return haveFrame || exifWidth != 0;
+    }
+
+    // Parses a TIFF header and the IFD0, Exif and GPS directories, plus IFD1 when the thumbnail is wanted
+    static bool readTiff(const uint8_t* base, size_t size, ImageSummary& summary, bool useImageSize, bool withThumbnail)
+    {
+        if (size < 8)
+        {
+            return false;
+        }
+        TiffView view{ base, size, base[0] == 'I' };
+        if (view.u16(2) != 42)
+        {
+            return false;
+        }
+
+        uint32_t exifIfd = 0;
+        uint32_t gpsIfd = 0;
+        uint32_t nextIfd = 0;
+        std::string dateTime;
+
+        bool ok = walkIfd(view, view.u32(4), &nextIfd, [&](const IfdEntry& e)
+        {
+            switch (e.tag)
+            {
+                case 0x0100:
+                    if (useImageSize) summary.width = readUnsigned(view, e);
+                    break;
+                case 0x0101:
+                    if (useImageSize) summary.height = readUnsigned(view, e);
+                    break;
+                case 0x010F:
+                    summary.make = readAscii(view, e);
+                    break;
+                case 0x0110:
+                    summary.model = readAscii(view, e);
+                    break;
+                case 0x0112:
+                    summary.orientation = static_cast<uint16_t>(readUnsigned(view, e));
+                    break;
+                case 0x0132:
+                    dateTime = readAscii(view, e);
+                    break;
+                case 0x8769:
+                    exifIfd = readUnsigned(view, e);
+                    break;
+                case 0x8825:
+                    gpsIfd = readUnsigned(view, e);
+                    break;
+            }
+        });
+        if (!ok)
+        {
+            return false;
+        }
+
+        if (exifIfd != 0)
+        {
+            walkIfd(view, exifIfd, nullptr, [&](const IfdEntry& e)
+            {
+                switch (e.tag)
+                {
+                    case 0x9003:
+                        summary.dateTime = readAscii(view, e);
+                        break;
+                    case 0xA002:
+                        if (summary.width == 0) summary.width = readUnsigned(view, e);
+                        break;
+                    case 0xA003:
+                        if (summary.height == 0) summary.height = readUnsigned(view, e);
+                        break;
+                }
+            });
+        }
+        if (summary.dateTime.empty())
+        {
+            summary.dateTime = std::move(dateTime);
+        }
+
+        if (gpsIfd != 0)
+        {
+            char latRef = 'N';
+            char lonRef = 'E';
+            uint8_t altRef = 0;
+            bool haveLat = false;
+            bool haveLon = false;
+            walkIfd(view, gpsIfd, nullptr, [&](const IfdEntry& e)
+            {
+                switch (e.tag)
+                {
+                    case 0x0001:
+                        latRef = e.count > 0 ? static_cast<char>(base[e.valueOffset]) : 'N';
+                        break;
+                    case 0x0002:
+                        haveLat = readDegrees(view, e, summary.latitude);
+                        break;
+                    case 0x0003:
+                        lonRef = e.count > 0 ? static_cast<char>(base[e.valueOffset]) : 'E';
+                        break;
+                    case 0x0004:
+                        haveLon = readDegrees(view, e, summary.longitude);
+                        break;
+                    case 0x0005:
+                        altRef = e.count > 0 ? base[e.valueOffset] : 0;
+                        break;
+                    case 0x0006:
+                        summary.altitude = readRational(view, e, 0);
+                        break;
+                }
+            });
+            summary.hasGps = haveLat && haveLon;
+            if (latRef == 'S') summary.latitude = -summary.latitude;
+            if (lonRef == 'W') summary.longitude = -summary.longitude;
+            if (altRef == 1) summary.altitude = -summary.altitude;
+        }
+
+        if (withThumbnail && nextIfd != 0)
+        {
+            uint32_t thumbOffset = 0;
+            uint32_t thumbLength = 0;
+            walkIfd(view, nextIfd, nullptr, [&](const IfdEntry& e)
+            {
+                if (e.tag == 0x0201)
+                    thumbOffset = readUnsigned(view, e);
+                else if (e.tag == 0x0202)
+                    thumbLength = readUnsigned(view, e);
+            });
+            if (thumbOffset != 0 && thumbLength != 0 && static_cast<size_t>(thumbOffset) + thumbLength <= view.size)
+            {
+                summary.thumbnail.assign(base + thumbOffset, base + thumbOffset + thumbLength);
+            }
+        }
+        return true;
+    }
+
+    // Calls 'visit' for every well-formed entry of the IFD at 'offset' and stores the offset of the
+    // following IFD in 'nextOffset' if given. Returns false if the directory lies outside the TIFF block
+    template <typename Visitor>
+    static bool walkIfd(const TiffView& view, uint32_t offset, uint32_t* nextOffset, Visitor&& visit)
+    {
+        if (offset < 8 || static_cast<size_t>(offset) + 2 > view.size)
+        {
+            return false;
+        }
+        uint16_t count = view.u16(offset);
+        size_t entries = static_cast<size_t>(offset) + 2;
+        if (entries + static_cast<size_t>(count) * 12 + 4 > view.size)
+        {
+            return false;
+        }
+        if (nextOffset)
+        {
+            *nextOffset = view.u32(entries + static_cast<size_t>(count) * 12);
+        }
+
+        for (uint16_t i = 0; i < count; ++i)
+        {
+            size_t pos = entries + static_cast<size_t>(i) * 12;
+            IfdEntry e{ view.u16(pos), view.u16(pos + 2), view.u32(pos + 4), pos + 8 };
+            size_t unit = typeSize(e.type);
+            if (unit == 0)
+            {
+                continue;
+            }
+            size_t bytes = unit * e.count;
+            if (bytes > 4)
+            {
+                e.valueOffset = view.u32(pos + 8);
+            }
+            if (e.count == 0 || e.valueOffset + bytes > view.size || bytes / unit != e.count)
+            {
+                continue;
+            }
+            visit(e);
+        }
+        return true;
+    }
+
+    static uint32_t readUnsigned(const TiffView& view, const IfdEntry& e)
+    {
+        switch (e.type)
+        {
+            case TypeByte:
+                return view.base[e.valueOffset];
+            case TypeShort:
+                return view.u16(e.valueOffset);
+            case TypeLong:
+                return view.u32(e.valueOffset);
+            default:
+                return 0;
+        }
+    }
+
+    static std::string readAscii(const TiffView& view, const IfdEntry& e)
+    {
+        if (e.type != TypeAscii)
+        {
+            return {};
+        }
+        const char* text = reinterpret_cast<const char*>(view.base + e.valueOffset);
+        size_t length = strnlen(text, e.count);
+        // Camera strings are often padded with trailing spaces
+        while (length > 0 && text[length - 1] == ' ')
+        {
+            --length;
+        }
+        return std::string(text, length);
+    }
+
+    static double readRational(const TiffView& view, const IfdEntry& e, uint32_t index)
+    {
+        if (e.type != TypeRational || index >= e.count)
+        {
+            return 0.0;
+        }
+        size_t pos = e.valueOffset + static_cast<size_t>(index) * 8;
+        uint32_t numerator = view.u32(pos);
+        uint32_t denominator = view.u32(pos + 4);
+        return denominator == 0 ? 0.0 : static_cast<double>(numerator) / denominator;
+    }
+
+    // Converts a degrees/minutes/seconds rational triple into decimal degrees
+    static bool readDegrees(const TiffView& view, const IfdEntry& e, double& degrees)
+    {
+        if (e.type != TypeRational || e.count < 3)
+        {
+            return false;
+        }
+        degrees = readRational(view, e, 0) + readRational(view, e, 1) / 60.0 + readRational(view, e, 2) / 3600.0;
+        return true;
+    }
+};
@@ -0,0 +1,273 @@
+#pragma once
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <sqlite3.h>
+#include "fastexifreader.h"
+
+// ImageIndex is a persistent SQLite cache of catalogue metadata and embedded thumbnails.
+// Each row carries the size/mtime fingerprint of the file it was read from, so a rescan
+// only needs to re-read files whose fingerprint changed
+class ImageIndex
+{
+public:
+    // Size and modification time recorded when a file was last indexed
+    struct Fingerprint
+    {
+        int64_t size;
+        int64_t mtime;
+    };
+
+    // Optional filters for query(); empty/zero fields are ignored
+    struct QueryFilter
+    {
+        int year{ 0 };
+        std::string camera;
+    };
+
+    // Opens (or creates) the database file and its schema
+    explicit ImageIndex(const std::string& dbPath)
+    {
+        if (sqlite3_open(dbPath.c_str(), &m_db) != SQLITE_OK)
+        {
+            std::cerr << "Error opening database: " << sqlite3_errmsg(m_db) << "\n";
+            sqlite3_close(m_db);
+            m_db = nullptr;
+            return;
+        }
+        executeQuery("PRAGMA journal_mode=WAL;");
+        executeQuery("PRAGMA synchronous=NORMAL;");
+        executeQuery(
+            "CREATE TABLE IF NOT EXISTS images ("
+            "id INTEGER PRIMARY KEY, "
+            "path TEXT UNIQUE NOT NULL, "
+            "size INTEGER, "
+            "mtime INTEGER, "
+            "width INTEGER, "
+            "height INTEGER, "
+            "capture_time TEXT, "
+            "camera TEXT, "
+            "latitude REAL, "
+            "longitude REAL, "
+            "thumbnail BLOB);");
+        // Capture-time ranges and camera + time lookups are the two query shapes that must stay index-only
+        executeQuery("CREATE INDEX IF NOT EXISTS idx_images_capture_time ON images (capture_time);");
+        executeQuery("CREATE INDEX IF NOT EXISTS idx_images_camera ON images (camera COLLATE NOCASE, capture_time);");
+
+        prepare("INSERT INTO images (path, size, mtime, width, height, capture_time, camera, latitude, longitude, thumbnail) "
+                "VALUES (?1, ?2, ?3, ?4, ?5, ?6, ?7, ?8, ?9, ?10) "
+                "ON CONFLICT(path) DO UPDATE SET size = excluded.size, mtime = excluded.mtime, "
+                "width = excluded.width, height = excluded.height, capture_time = excluded.capture_time, "
+                "camera = excluded.camera, latitude = excluded.latitude, longitude = excluded.longitude, "
+                "thumbnail = excluded.thumbnail;", &m_upsertStmt);
+        prepare("DELETE FROM images WHERE path = ?1;", &m_deleteStmt);
+    }
+
+    ~ImageIndex()
+    {
+        sqlite3_finalize(m_upsertStmt);
+        sqlite3_finalize(m_deleteStmt);
+        sqlite3_close(m_db);
+    }
+
+    ImageIndex(const ImageIndex&) = delete;
+    ImageIndex& operator=(const ImageIndex&) = delete;
+
+    bool isOpen() const
+    {
+        return m_db != nullptr && m_upsertStmt != nullptr && m_deleteStmt != nullptr;
+    }
+
+    // Loads the fingerprint of every indexed file in a single pass over the table
+    std::unordered_map<std::string, Fingerprint> loadFingerprints()
+    {
+        std::unordered_map<std::string, Fingerprint> fingerprints;
+        sqlite3_stmt* stmt = nullptr;
+        if (sqlite3_prepare_v2(m_db, "SELECT path, size, mtime FROM images;", -1, &stmt, nullptr) == SQLITE_OK)
+        {
+            while (sqlite3_step(stmt) == SQLITE_ROW)
+            {
+                std::string path = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+                fingerprints[path] = { sqlite3_column_int64(stmt, 1), sqlite3_column_int64(stmt, 2) };
+            }
+        }
+        sqlite3_finalize(stmt);
+        return fingerprints;
+    }
+
+    // Groups the following store()/remove() calls into one transaction
+    void beginBatch()
+    {
+        executeQuery("BEGIN;");
+    }
+
+    void commitBatch()
+    {
+        executeQuery("COMMIT;");
+    }
+
+    // Inserts or refreshes the row of a single image
+    void store(const ImageSummary& summary, const Fingerprint& fingerprint)
+    {
+        sqlite3_stmt* stmt = m_upsertStmt;
+        std::string captureTime = normaliseDateTime(summary.dateTime);
+        std::string camera = cameraName(summary.make, summary.model);
+
+        sqlite3_bind_text(stmt, 1, summary.filepath.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_int64(stmt, 2, fingerprint.size);
+        sqlite3_bind_int64(stmt, 3, fingerprint.mtime);
+        sqlite3_bind_int64(stmt, 4, summary.width);
+        sqlite3_bind_int64(stmt, 5, summary.height);
+        bindOptionalText(stmt, 6, captureTime);
+        bindOptionalText(stmt, 7, camera);
+        if (summary.hasGps)
+        {
+            sqlite3_bind_double(stmt, 8, summary.latitude);
+            sqlite3_bind_double(stmt, 9, summary.longitude);
+        }
+        else
+        {
+            sqlite3_bind_null(stmt, 8);
+            sqlite3_bind_null(stmt, 9);
+        }
+        if (!summary.thumbnail.empty())
+        {
+            sqlite3_bind_blob(stmt, 10, summary.thumbnail.data(), static_cast<int>(summary.thumbnail.size()), SQLITE_STATIC);
+        }
+        else
+        {
+            sqlite3_bind_null(stmt, 10);
+        }
+
+        if (sqlite3_step(stmt) != SQLITE_DONE)
+        {
+            std::cerr << "SQL error on insert: " << sqlite3_errmsg(m_db) << "\n";
+        }
+        sqlite3_reset(stmt);
+        sqlite3_clear_bindings(stmt);
+    }
+
+    // Drops the row of a file that no longer exists or can no longer be read
+    void remove(const std::string& path)
+    {
+        sqlite3_bind_text(m_deleteStmt, 1, path.c_str(), -1, SQLITE_TRANSIENT);
+        if (sqlite3_step(m_deleteStmt) != SQLITE_DONE)
+        {
+            std::cerr << "SQL error on delete: " << sqlite3_errmsg(m_db) << "\n";
+        }
+        sqlite3_reset(m_deleteStmt);
+    }
+
+    // Prints the images matching the filter, ordered by capture time. Both filters are
+    // answered from the indexes: a year becomes a half-open capture_time range
+    size_t query(const QueryFilter& filter, std::ostream& out)
+    {
+        std::string sql = "SELECT path, capture_time, camera, width, height, latitude, longitude, "
+                          "length(thumbnail) FROM images WHERE 1";
+        if (filter.year != 0)
+        {
+            sql += " AND capture_time >= ?1 AND capture_time < ?2";
+        }
+        if (!filter.camera.empty())
+        {
+            sql += " AND camera = ?3 COLLATE NOCASE";
+        }
+        sql += " ORDER BY capture_time;";
+
+        sqlite3_stmt* stmt = nullptr;
+        if (sqlite3_prepare_v2(m_db, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK)
+        {
+            std::cerr << "Failed to prepare query: " << sqlite3_errmsg(m_db) << "\n";
+            return 0;
+        }
+        if (filter.year != 0)
+        {
+            std::string from = std::to_string(filter.year) + "-01-01";
+            std::string to = std::to_string(filter.year + 1) + "-01-01";
+            sqlite3_bind_text(stmt, 1, from.c_str(), -1, SQLITE_TRANSIENT);
+            sqlite3_bind_text(stmt, 2, to.c_str(), -1, SQLITE_TRANSIENT);
+        }
+        if (!filter.camera.empty())
+        {
+            sqlite3_bind_text(stmt, 3, filter.camera.c_str(), -1, SQLITE_TRANSIENT);
+        }
+
+        size_t matches = 0;
+        while (sqlite3_step(stmt) == SQLITE_ROW)
+        {
+            out << "File: " << columnText(stmt, 0) << "\n";
+            out << "  Date: " << columnText(stmt, 1) << "\n";
+            out << "  Camera: " << columnText(stmt, 2) << "\n";
+            out << "  Dimensions: " << sqlite3_column_int64(stmt, 3) << "x" << sqlite3_column_int64(stmt, 4) << "\n";
+            if (sqlite3_column_type(stmt, 5) != SQLITE_NULL)
+            {
+                out << "  GPS: " << sqlite3_column_double(stmt, 5) << ", " << sqlite3_column_double(stmt, 6) << "\n";
+            }
+            out << "  Thumbnail: " << sqlite3_column_int64(stmt, 7) << " bytes\n";
+            ++matches;
+        }
+        sqlite3_finalize(stmt);
+        return matches;
+    }
+
+private:
+    sqlite3* m_db{ nullptr };
+    sqlite3_stmt* m_upsertStmt{ nullptr };
+    sqlite3_stmt* m_deleteStmt{ nullptr };
+
+    // Executes an SQL query and prints an error if it fails
+    void executeQuery(const std::string& query)
+    {
+        char* errMsg = nullptr;
+        if (m_db && sqlite3_exec(m_db, query.c_str(), nullptr, nullptr, &errMsg) != SQLITE_OK)
+        {
+            std::cerr << "SQL error: " << errMsg << "\n";
+            sqlite3_free(errMsg);
+        }
+    }
+
+    void prepare(const char* sql, sqlite3_stmt** stmt)
+    {
+        if (m_db && sqlite3_prepare_v2(m_db, sql, -1, stmt, nullptr) != SQLITE_OK)
+        {
+            std::cerr << "Failed to prepare statement: " << sqlite3_errmsg(m_db) << "\n";
+        }
+    }
+
+    static void bindOptionalText(sqlite3_stmt* stmt, int index, const std::string& text)
+    {
+        if (text.empty())
+            sqlite3_bind_null(stmt, index);
+        else
+            sqlite3_bind_text(stmt, index, text.c_str(), -1, SQLITE_TRANSIENT);
+    }
+
+    static std::string columnText(sqlite3_stmt* stmt, int column)
+    {
+        const unsigned char* text = sqlite3_column_text(stmt, column);
+        return text ? reinterpret_cast<const char*>(text) : "";
+    }
+
+    // Converts the EXIF "YYYY:MM:DD HH:MM:SS" format into the sortable ISO form "YYYY-MM-DD HH:MM:SS"
+    static std::string normaliseDateTime(std::string dateTime)
+    {
+        if (dateTime.size() >= 10 && dateTime[4] == ':' && dateTime[7] == ':')
+        {
+            dateTime[4] = '-';
+            dateTime[7] = '-';
+        }
+        return dateTime;
+    }
+
+    // Joins make and model, dropping the make when the model already starts with it ("Canon Canon EOS R5")
+    static std::string cameraName(const std::string& make, const std::string& model)
+    {
+        if (model.empty())
+            return make;
+        if (make.empty() || model.compare(0, make.size(), make) == 0)
+            return model;
+        return make + " " + model;
+    }
+};
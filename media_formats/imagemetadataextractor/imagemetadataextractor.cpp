@@ -1,70 +1,739 @@
 #include <iostream>
 #include <filesystem>
 #include <exiv2/exiv2.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <sstream>
 #include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+#include <sys/stat.h>
+#include "fastexifreader.h"
+#include "imageindex.h"
+#include "perceptualhash.h"
 
 namespace fs = std::filesystem;
 
-// ImageMetadataViewer class scans a directory for image files and extracts EXIF metadata using Exiv2
+// ImageMetadataViewer class scans a directory tree for image files and extracts EXIF metadata
+// using Exiv2 on a pool of worker threads
 class ImageMetadataViewer
 {
 public:
-    // Scans the given directory for image files and processes each one
+    // In catalogue mode only the ImageSummary tags are printed, read through FastExifReader
+    // whenever possible. 'useFastPath' can be disabled to measure the Exiv2-only baseline.
+    // numThreads == 0 uses the hardware concurrency
+    ImageMetadataViewer(bool catalogueMode = false, bool useFastPath = true, unsigned int numThreads = 0)
+        : m_catalogueMode(catalogueMode), m_useFastPath(useFastPath), m_numThreads(numThreads)
+    {
+        if (m_numThreads == 0)
+        {
+            m_numThreads = std::thread::hardware_concurrency();
+            if (m_numThreads == 0)
+                m_numThreads = 2;
+        }
+    }
+
+    // Recursively scans the given directory for image files and processes them in parallel
     void scanDirectory(const std::string& path)
     {
-        for (const auto & entry : fs::directory_iterator(path))
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::string> files = collectImageFiles(path);
+
+        size_t fastPathHits = 0;
+        unsigned int numThreads = runParallel(files.size(), [&](size_t i, WorkerContext& context)
+        {
+            if (m_catalogueMode)
+            {
+                catalogueFile(files[i], context);
+            }
+            else
+            {
+                processFile(files[i], context);
+            }
+        }, &fastPathHits);
+
+        if (m_catalogueMode)
+        {
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            std::cerr << "Catalogued " << files.size() << " images in " << std::fixed << std::setprecision(3)
+                      << seconds << " s using " << numThreads << " threads (" << fastPathHits << " via fast path)\n";
+        }
+    }
+
+    // Brings the SQLite index up to date with the directory tree. Files whose size and mtime match
+    // the stored fingerprint are skipped; changed files are read in parallel chunks (including their
+    // embedded thumbnail) and written in one transaction per chunk; rows of deleted or unreadable files are dropped
+    void indexDirectory(const std::string& path, ImageIndex& index)
+    {
+        auto start = std::chrono::steady_clock::now();
+        // Rows are keyed on absolute paths so that the index does not depend on the working directory
+        fs::path root = fs::absolute(path).lexically_normal();
+        std::vector<std::string> files = collectImageFiles(root.string());
+        std::unordered_map<std::string, ImageIndex::Fingerprint> known = index.loadFingerprints();
+
+        std::vector<std::string> changed;
+        std::vector<ImageIndex::Fingerprint> changedFingerprints;
+        std::unordered_set<std::string> seen;
+        for (const auto& file : files)
+        {
+            struct stat st;
+            if (::stat(file.c_str(), &st) != 0)
+            {
+                continue;
+            }
+            ImageIndex::Fingerprint fingerprint{ static_cast<int64_t>(st.st_size), static_cast<int64_t>(st.st_mtime) };
+            seen.insert(file);
+            auto it = known.find(file);
+            if (it == known.end() || it->second.size != fingerprint.size || it->second.mtime != fingerprint.mtime)
+            {
+                changed.push_back(file);
+                changedFingerprints.push_back(fingerprint);
+            }
+        }
+
+        // Thumbnails make summaries heavy, so only one chunk is held in memory at a time
+        constexpr size_t ChunkSize = 1024;
+        std::vector<ImageSummary> summaries;
+        std::vector<char> readOk;
+        size_t unreadable = 0;
+        for (size_t begin = 0; begin < changed.size(); begin += ChunkSize)
+        {
+            size_t count = std::min(ChunkSize, changed.size() - begin);
+            summaries.assign(count, ImageSummary());
+            readOk.assign(count, 0);
+            runParallel(count, [&](size_t i, WorkerContext& context)
+            {
+                readOk[i] = readSummary(changed[begin + i], summaries[i], true, context) ? 1 : 0;
+            }, nullptr);
+
+            index.beginBatch();
+            for (size_t i = 0; i < count; ++i)
+            {
+                if (readOk[i])
+                {
+                    index.store(summaries[i], changedFingerprints[begin + i]);
+                }
+                else
+                {
+                    // A changed file that can no longer be read must not keep its old metadata
+                    ++unreadable;
+                    if (known.count(changed[begin + i]) != 0)
+                    {
+                        index.remove(changed[begin + i]);
+                    }
+                }
+            }
+            index.commitBatch();
+        }
+
+        // Drop rows for files that disappeared from the scanned tree
+        std::string prefix = (root / "").string();
+        size_t removed = 0;
+        index.beginBatch();
+        for (const auto& entry : known)
         {
-            if (fs::is_regular_file(entry) && isImageFile(entry.path().extension().string()))
+            if (entry.first.compare(0, prefix.size(), prefix) == 0 && seen.find(entry.first) == seen.end())
             {
-                processFile(entry.path().string());
+                index.remove(entry.first);
+                ++removed;
             }
         }
+        index.commitBatch();
+
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cerr << "Indexed " << files.size() << " images in " << std::fixed << std::setprecision(3) << seconds
+                  << " s (" << changed.size() << " new or changed, " << files.size() - changed.size()
+                  << " unchanged, " << removed << " removed, " << unreadable << " unreadable)\n";
+    }
+
+    // Hashes every JPEG under the directory in parallel and prints groups of near-duplicates, i.e.
+    // images whose perceptual hashes differ by at most 'threshold' bits. Candidate pairs come from
+    // BK-tree radius queries, and groups are formed with union-find over those pairs
+    void findDuplicates(const std::string& path, int threshold)
+    {
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::string> files;
+        for (auto& file : collectImageFiles(path))
+        {
+            if (isJpegFile(fs::path(file).extension().string()))
+            {
+                files.push_back(std::move(file));
+            }
+        }
+        // Sorted paths make the output stable: groups are rooted at their smallest index, so they
+        // come out ordered by first path, with their members in path order
+        std::sort(files.begin(), files.end());
+
+        std::vector<uint64_t> hashes(files.size());
+        std::vector<char> hashed(files.size(), 0);
+        std::atomic<size_t> fromThumbnail{ 0 };
+        runParallel(files.size(), [&](size_t i, WorkerContext& context)
+        {
+            bool usedThumbnail = false;
+            if (hashImageFile(files[i], hashes[i], usedThumbnail))
+            {
+                hashed[i] = 1;
+                fromThumbnail += usedThumbnail ? 1 : 0;
+            }
+            else
+            {
+                context.err << "Error: Could not decode " << files[i] << "\n";
+            }
+        }, nullptr);
+        double hashSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        BkTree tree;
+        for (size_t i = 0; i < files.size(); ++i)
+        {
+            if (hashed[i])
+            {
+                tree.insert(hashes[i], static_cast<uint32_t>(i));
+            }
+        }
+
+        std::vector<uint32_t> parent(files.size());
+        for (size_t i = 0; i < parent.size(); ++i)
+        {
+            parent[i] = static_cast<uint32_t>(i);
+        }
+        auto findRoot = [&](uint32_t i)
+        {
+            while (parent[i] != i)
+            {
+                parent[i] = parent[parent[i]];
+                i = parent[i];
+            }
+            return i;
+        };
+        for (size_t i = 0; i < files.size(); ++i)
+        {
+            if (!hashed[i])
+            {
+                continue;
+            }
+            tree.query(hashes[i], threshold, [&](uint32_t other, int)
+            {
+                uint32_t a = findRoot(static_cast<uint32_t>(i));
+                uint32_t b = findRoot(other);
+                if (a != b)
+                {
+                    parent[std::max(a, b)] = std::min(a, b);
+                }
+            });
+        }
+
+        std::map<uint32_t, std::vector<uint32_t>> groups;
+        for (size_t i = 0; i < files.size(); ++i)
+        {
+            if (hashed[i])
+            {
+                groups[findRoot(static_cast<uint32_t>(i))].push_back(static_cast<uint32_t>(i));
+            }
+        }
+
+        size_t groupCount = 0;
+        for (const auto& group : groups)
+        {
+            if (group.second.size() < 2)
+            {
+                continue;
+            }
+            ++groupCount;
+            uint64_t reference = hashes[group.second.front()];
+            std::cout << "Group " << groupCount << " (" << group.second.size() << " images):\n";
+            for (uint32_t member : group.second)
+            {
+                std::cout << "  " << files[member] << "  [hash " << std::hex << std::setw(16) << std::setfill('0')
+                          << hashes[member] << std::dec << std::setfill(' ') << ", distance "
+                          << PerceptualHasher::distance(reference, hashes[member]) << "]\n";
+            }
+        }
+
+        double totalSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cerr << "Hashed " << files.size() << " JPEG images in " << std::fixed << std::setprecision(3) << hashSeconds
+                  << " s (" << fromThumbnail << " from EXIF thumbnails), found " << groupCount
+                  << " duplicate groups in " << totalSeconds << " s total\n";
     }
 
 private:
+    // Number of files a worker formats before taking the output lock
+    static constexpr size_t BatchSize = 64;
+
+    // Per-thread state: each worker opens its own Exiv2 images and formats its results into
+    // private buffers, which are written to the console in batches under a single lock
+    struct WorkerContext
+    {
+        std::ostringstream out;
+        std::ostringstream err;
+        size_t pending{ 0 };
+        size_t fastPathHits{ 0 };
+    };
+
+    bool m_catalogueMode;
+    bool m_useFastPath;
+    unsigned int m_numThreads;
+    std::mutex m_outputMutex;
+
+    // Recursively collects image files, skipping directories that cannot be read
+    std::vector<std::string> collectImageFiles(const std::string& path)
+    {
+        std::vector<std::string> files;
+        std::error_code ec;
+        fs::recursive_directory_iterator it(path, fs::directory_options::skip_permission_denied, ec);
+        for (; !ec && it != fs::recursive_directory_iterator(); it.increment(ec))
+        {
+            if (it->is_regular_file(ec) && isImageFile(it->path().extension().string()))
+            {
+                files.push_back(it->path().string());
+            }
+        }
+        if (ec)
+        {
+            std::cerr << "Error scanning " << path << ": " << ec.message() << "\n";
+        }
+        return files;
+    }
+
+    // Runs 'task(i, context)' for every i in [0, count) on the worker pool. Workers claim indexes from
+    // a shared counter and flush their buffered output every BatchSize items. Returns the thread count
+    template <typename Task>
+    unsigned int runParallel(size_t count, Task&& task, size_t* fastPathHits)
+    {
+        // Exiv2 lazily initialises its XMP toolkit, which is not thread-safe; do it once up front
+        Exiv2::XmpParser::initialize();
+
+        std::atomic<size_t> nextIndex{ 0 };
+        std::atomic<size_t> hits{ 0 };
+        unsigned int numThreads = static_cast<unsigned int>(std::min<size_t>(m_numThreads, std::max<size_t>(count, 1)));
+
+        std::vector<std::thread> pool;
+        for (unsigned int t = 0; t < numThreads; ++t)
+        {
+            pool.emplace_back([&]()
+            {
+                WorkerContext context;
+                for (size_t i = nextIndex++; i < count; i = nextIndex++)
+                {
+                    task(i, context);
+                    if (++context.pending >= BatchSize)
+                    {
+                        flush(context);
+                    }
+                }
+                flush(context);
+                hits += context.fastPathHits;
+            });
+        }
+        for (auto& t : pool)
+        {
+            t.join();
+        }
+
+        if (fastPathHits)
+        {
+            *fastPathHits = hits;
+        }
+        return numThreads;
+    }
+
+    // Writes a worker's buffered results to the console and resets its buffers
+    void flush(WorkerContext& context)
+    {
+        std::string out = context.out.str();
+        std::string err = context.err.str();
+        if (!out.empty() || !err.empty())
+        {
+            std::lock_guard<std::mutex> lock(m_outputMutex);
+            std::cout << out;
+            std::cerr << err;
+        }
+        context.out.str(std::string());
+        context.err.str(std::string());
+        context.pending = 0;
+    }
+
     // Processes a single file by extracting and displaying its EXIF metadata
-    void processFile(const std::string& filepath)
+    void processFile(const std::string& filepath, WorkerContext& context)
     {
         try
         {
             auto image = Exiv2::ImageFactory::open(filepath);
             if (!image)
             {
-                std::cerr << "Error: Could not read " << filepath << "\n";
+                context.err << "Error: Could not read " << filepath << "\n";
                 return;
             }
 
             image->readMetadata();
             Exiv2::ExifData& exifData = image->exifData();
 
-            std::cout << "File: " << filepath << "\n";
+            context.out << "File: " << filepath << "\n";
             for (const auto& entry : exifData)
             {
-                std::cout << entry.key() << " = " << entry.value() << "\n";
+                context.out << entry.key() << " = " << entry.value() << "\n";
             }
-            std::cout << "---------------------------------------\n";
+            context.out << "---------------------------------------\n";
         }
         catch (const Exiv2::Error& e)
         {
-            std::cerr << "Error reading metadata: " << e.what() << "\n";
+            context.err << "Error reading metadata: " << e.what() << "\n";
         }
     }
 
-    // Checks if the file extension matches one of the supported image formats
-    bool isImageFile(const std::string& ext)
+    // Reads and prints the catalogue tags of a single file
+    void catalogueFile(const std::string& filepath, WorkerContext& context)
     {
-        return ext == ".jpg" || ext == ".jpeg" || ext == ".png" || ext == ".tiff" || ext == ".bmp";
+        ImageSummary summary;
+        if (readSummary(filepath, summary, false, context))
+        {
+            printSummary(summary, context.out);
+        }
+    }
+
+    // Reads the catalogue tags of a single file, falling back to Exiv2 for formats the fast reader rejects
+    bool readSummary(const std::string& filepath, ImageSummary& summary, bool withThumbnail, WorkerContext& context)
+    {
+        if (m_useFastPath && FastExifReader::read(filepath, summary, withThumbnail))
+        {
+            ++context.fastPathHits;
+            return true;
+        }
+        summary = ImageSummary();
+        return readSummaryWithExiv2(filepath, summary, withThumbnail, context);
+    }
+
+    // Fills the same tag set as FastExifReader using the full Exiv2 parser
+    bool readSummaryWithExiv2(const std::string& filepath, ImageSummary& summary, bool withThumbnail, WorkerContext& context)
+    {
+        try
+        {
+            auto image = Exiv2::ImageFactory::open(filepath);
+            if (!image)
+            {
+                context.err << "Error: Could not read " << filepath << "\n";
+                return false;
+            }
+
+            image->readMetadata();
+            const Exiv2::ExifData& exifData = image->exifData();
+
+            summary.filepath = filepath;
+            summary.width = static_cast<uint32_t>(image->pixelWidth());
+            summary.height = static_cast<uint32_t>(image->pixelHeight());
+            summary.make = findString(exifData, "Exif.Image.Make");
+            summary.model = findString(exifData, "Exif.Image.Model");
+            summary.dateTime = findString(exifData, "Exif.Photo.DateTimeOriginal");
+            if (summary.dateTime.empty())
+            {
+                summary.dateTime = findString(exifData, "Exif.Image.DateTime");
+            }
+            summary.orientation = findOrientation(exifData);
+
+            double latitude = 0.0;
+            double longitude = 0.0;
+            if (findDegrees(exifData, "Exif.GPSInfo.GPSLatitude", latitude)
+                && findDegrees(exifData, "Exif.GPSInfo.GPSLongitude", longitude))
+            {
+                summary.hasGps = true;
+                summary.latitude = findString(exifData, "Exif.GPSInfo.GPSLatitudeRef") == "S" ? -latitude : latitude;
+                summary.longitude = findString(exifData, "Exif.GPSInfo.GPSLongitudeRef") == "W" ? -longitude : longitude;
+            }
+
+            if (withThumbnail && !exifData.empty())
+            {
+                Exiv2::ExifThumbC thumb(exifData);
+                Exiv2::DataBuf buffer = thumb.copy();
+#if EXIV2_TEST_VERSION(0, 28, 0)
+                summary.thumbnail.assign(buffer.c_data(), buffer.c_data() + buffer.size());
+#else
+                summary.thumbnail.assign(buffer.pData_, buffer.pData_ + buffer.size_);
+#endif
+            }
+            return true;
+        }
+        catch (const std::exception& e)
+        {
+            context.err << "Error reading metadata: " << e.what() << "\n";
+            return false;
+        }
+    }
+
+    static std::string findString(const Exiv2::ExifData& exifData, const char* key)
+    {
+        auto it = exifData.findKey(Exiv2::ExifKey(key));
+        return it != exifData.end() ? it->toString() : std::string();
+    }
+
+    static uint16_t findOrientation(const Exiv2::ExifData& exifData)
+    {
+        std::string text = findString(exifData, "Exif.Image.Orientation");
+        uint16_t orientation = 0;
+        auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), orientation);
+        return ec == std::errc() && end == text.data() + text.size() ? orientation : 0;
+    }
+
+    static bool findDegrees(const Exiv2::ExifData& exifData, const char* key, double& degrees)
+    {
+        auto it = exifData.findKey(Exiv2::ExifKey(key));
+        if (it == exifData.end() || it->count() < 3)
+        {
+            return false;
+        }
+        degrees = 0.0;
+        double scale = 1.0;
+        for (int i = 0; i < 3; ++i, scale *= 60.0)
+        {
+            Exiv2::Rational r = it->toRational(i);
+            if (r.second != 0)
+            {
+                degrees += static_cast<double>(r.first) / r.second / scale;
+            }
+        }
+        return true;
+    }
+
+    // Prints the catalogue tags of a single image
+    void printSummary(const ImageSummary& summary, std::ostream& out)
+    {
+        out << "File: " << summary.filepath << "\n";
+        out << "Date: " << summary.dateTime << "\n";
+        out << "Camera: " << summary.make << " " << summary.model << "\n";
+        out << "Dimensions: " << summary.width << "x" << summary.height << "\n";
+        out << "Orientation: " << summary.orientation << "\n";
+        if (summary.hasGps)
+        {
+            out << "GPS: " << std::fixed << std::setprecision(6) << summary.latitude << ", "
+                << summary.longitude << std::defaultfloat << "\n";
+        }
+        out << "---------------------------------------\n";
+    }
+
+    // Computes the perceptual hash of a JPEG, preferring the embedded EXIF thumbnail when its aspect
+    // ratio matches the main image (letterboxed thumbnails would hash differently from their image)
+    bool hashImageFile(const std::string& filepath, uint64_t& hash, bool& usedThumbnail)
+    {
+        ImageSummary summary;
+        if (m_useFastPath && FastExifReader::read(filepath, summary, true) && !summary.thumbnail.empty()
+            && summary.width != 0 && summary.height != 0)
+        {
+            int thumbWidth = 0;
+            int thumbHeight = 0;
+            if (jpegDimensions(summary.thumbnail, thumbWidth, thumbHeight) && thumbHeight != 0)
+            {
+                double imageAspect = static_cast<double>(summary.width) / summary.height;
+                double thumbAspect = static_cast<double>(thumbWidth) / thumbHeight;
+                if (std::abs(imageAspect - thumbAspect) / imageAspect < 0.02
+                    && PerceptualHasher::hashJpegBuffer(summary.thumbnail, hash))
+                {
+                    usedThumbnail = true;
+                    return true;
+                }
+            }
+        }
+        return PerceptualHasher::hashJpegFile(filepath, hash);
+    }
+
+    // Reads the frame size of an in-memory JPEG without decoding it
+    static bool jpegDimensions(const std::vector<uint8_t>& jpeg, int& width, int& height)
+    {
+        size_t pos = 2;
+        while (pos + 9 < jpeg.size() && jpeg[pos] == 0xFF)
+        {
+            uint8_t marker = jpeg[pos + 1];
+            size_t length = (static_cast<size_t>(jpeg[pos + 2]) << 8) | jpeg[pos + 3];
+            if (marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC)
+            {
+                height = (jpeg[pos + 5] << 8) | jpeg[pos + 6];
+                width = (jpeg[pos + 7] << 8) | jpeg[pos + 8];
+                return true;
+            }
+            pos += 2 + length;
+        }
+        return false;
+    }
+
+    bool isJpegFile(std::string ext)
+    {
+        std::transform(ext.begin(), ext.end(), ext.begin(),
+                       [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        return ext == ".jpg" || ext == ".jpeg";
+    }
+
+    // Checks if the file extension matches one of the supported image formats, ignoring case
+    // so that camera-generated names such as IMG_0001.JPG are included
+    bool isImageFile(std::string ext)
+    {
+        std::transform(ext.begin(), ext.end(), ext.begin(),
+                       [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        return ext == ".jpg" || ext == ".jpeg" || ext == ".png" || ext == ".tiff" || ext == ".tif" || ext == ".bmp";
     }
 };
 
-int main()
+// Prints the command line options
+void printUsage(const char* program)
+{
+    std::cerr << "Usage: " << program << " [--catalogue] [--no-fast-path] [--threads N] [--db FILE] DIRECTORY\n"
+              << "       " << program << " --index [--threads N] [--db FILE] DIRECTORY\n"
+              << "       " << program << " --query [--year YYYY] [--camera TEXT] [--db FILE]\n"
+              << "       " << program << " --duplicates [--threshold BITS] [--threads N] DIRECTORY" << std::endl;
+}
+
+// Parses a whole decimal count no larger than 'max'. Signs, spaces and trailing text are rejected
+bool parseCount(const std::string& text, uintmax_t max, uintmax_t& value)
 {
+    if (text.empty())
+    {
+        return false;
+    }
+    value = 0;
+    for (char c : text)
+    {
+        if (!std::isdigit(static_cast<unsigned char>(c)))
+        {
+            return false;
+        }
+        uintmax_t digit = static_cast<uintmax_t>(c - '0');
+        if (value > (max - digit) / 10)
+        {
+            return false;
+        }
+        value = value * 10 + digit;
+    }
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    bool catalogueMode = false;
+    bool useFastPath = true;
+    bool indexMode = false;
+    bool queryMode = false;
+    bool duplicatesMode = false;
+    int threshold = 6;
+    unsigned int numThreads = 0;
+    std::string dbPath = "images.db";
+    ImageIndex::QueryFilter filter;
     std::string directory;
-    std::cout << "Enter the directory containing image files: ";
-    std::getline(std::cin, directory);
 
-    ImageMetadataViewer viewer;
-    viewer.scanDirectory(directory);
+    // Reads the numeric value of option 'arg'; prints an error and returns false if it is invalid
+    auto numericValue = [&](const std::string& arg, const std::string& text, uintmax_t max, uintmax_t& value)
+    {
+        bool ok = parseCount(text, max, value);
+        if (!ok)
+        {
+            std::cerr << "Invalid value for " << arg << ": '" << text << "'" << std::endl;
+            printUsage(argv[0]);
+        }
+        return ok;
+    };
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        uintmax_t value = 0;
+        if (arg == "--catalogue")
+        {
+            catalogueMode = true;
+        }
+        else if (arg == "--no-fast-path")
+        {
+            useFastPath = false;
+        }
+        else if (arg == "--threads" && i + 1 < argc)
+        {
+            if (!numericValue(arg, argv[++i], 1024, value))
+                return 1;
+            numThreads = static_cast<unsigned int>(value);
+        }
+        else if (arg == "--index")
+        {
+            indexMode = true;
+        }
+        else if (arg == "--query")
+        {
+            queryMode = true;
+        }
+        else if (arg == "--duplicates")
+        {
+            duplicatesMode = true;
+        }
+        else if (arg == "--threshold" && i + 1 < argc)
+        {
+            if (!numericValue(arg, argv[++i], 64, value))
+                return 1;
+            threshold = static_cast<int>(value);
+        }
+        else if (arg == "--db" && i + 1 < argc)
+        {
+            dbPath = argv[++i];
+        }
+        else if (arg == "--year" && i + 1 < argc)
+        {
+            if (!numericValue(arg, argv[++i], 9999, value))
+                return 1;
+            filter.year = static_cast<int>(value);
+        }
+        else if (arg == "--camera" && i + 1 < argc)
+        {
+            filter.camera = argv[++i];
+        }
+        else if (arg.size() > 1 && arg[0] == '-')
+        {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            printUsage(argv[0]);
+            return 1;
+        }
+        else
+        {
+            directory = arg;
+        }
+    }
+
+    if (queryMode)
+    {
+        ImageIndex index(dbPath);
+        if (!index.isOpen())
+        {
+            return 1;
+        }
+        size_t matches = index.query(filter, std::cout);
+        std::cout << matches << " matching images\n";
+        return 0;
+    }
+
+    if (directory.empty())
+    {
+        std::cout << "Enter the directory containing image files: ";
+        std::getline(std::cin, directory);
+    }
+
+    ImageMetadataViewer viewer(catalogueMode, useFastPath, numThreads);
+    if (indexMode)
+    {
+        ImageIndex index(dbPath);
+        if (!index.isOpen())
+        {
+            return 1;
+        }
+        viewer.indexDirectory(directory, index);
+    }
+    else if (duplicatesMode)
+    {
+        viewer.findDuplicates(directory, threshold);
+    }
+    else
+    {
+        viewer.scanDirectory(directory);
+    }
 
     return 0;
 }
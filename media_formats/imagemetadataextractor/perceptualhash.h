@@ -0,0 +1,279 @@
+#pragma once
+
+#include <algorithm>
+#include <csetjmp>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <utility>
+#include <vector>
+#include <jpeglib.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// PerceptualHasher computes a 64-bit difference hash (dHash) of a JPEG image: the image is decoded
+// to greyscale, box-filtered down to 9x8 and each bit records whether a pixel is brighter than its
+// right neighbour. Resized and re-encoded copies of a photo end up a few bits apart.
+// Decoding uses libjpeg's DCT scaling, so a full-size photo is decoded at 1/8 resolution and an
+// embedded EXIF thumbnail can be hashed instead of the main image
+class PerceptualHasher
+{
+public:
+    // Hashes a JPEG held in memory, typically an EXIF thumbnail
+    static bool hashJpegBuffer(const std::vector<uint8_t>& jpeg, uint64_t& hash)
+    {
+        GreyImage image;
+        return decode(nullptr, &jpeg, image) && hashImage(image, hash);
+    }
+
+    // Hashes a JPEG file
+    static bool hashJpegFile(const std::string& filepath, uint64_t& hash)
+    {
+        FILE* file = std::fopen(filepath.c_str(), "rb");
+        if (!file)
+        {
+            return false;
+        }
+        GreyImage image;
+        bool ok = decode(file, nullptr, image) && hashImage(image, hash);
+        std::fclose(file);
+        return ok;
+    }
+
+    static int distance(uint64_t a, uint64_t b)
+    {
+        return __builtin_popcountll(a ^ b);
+    }
+
+private:
+    static constexpr int HashWidth = 9;
+    static constexpr int HashHeight = 8;
+
+    struct GreyImage
+    {
+        int width{ 0 };
+        int height{ 0 };
+        std::vector<uint8_t> pixels;
+    };
+
+    // libjpeg reports fatal errors through error_exit, which must not return
+    struct ErrorManager
+    {
+        jpeg_error_mgr base;
+        std::jmp_buf jump;
+    };
+
+    static void onError(j_common_ptr cinfo)
+    {
+        std::longjmp(reinterpret_cast<ErrorManager*>(cinfo->err)->jump, 1);
+    }
+
+    static void onMessage(j_common_ptr)
+    {
+        // Corrupt-data warnings are expected in large archives and are not worth printing
+    }
+
+    // Decodes either a FILE* or an in-memory buffer to greyscale, letting the decoder downscale by up
+    // to 8x while keeping at least 4 source pixels per output cell in each direction
+    static bool decode(FILE* file, const std::vector<uint8_t>* buffer, GreyImage& image)
+    {
+        jpeg_decompress_struct cinfo;
+        ErrorManager errors;
+        cinfo.err = jpeg_std_error(&errors.base);
+        errors.base.error_exit = onError;
+        errors.base.output_message = onMessage;
+
+        if (setjmp(errors.jump))
+        {
+            jpeg_destroy_decompress(&cinfo);
+            return false;
+        }
+
+        jpeg_create_decompress(&cinfo);
+        if (file)
+        {
+            jpeg_stdio_src(&cinfo, file);
+        }
+        else
+        {
+            jpeg_mem_src(&cinfo, const_cast<unsigned char*>(buffer->data()), static_cast<unsigned long>(buffer->size()));
+        }
+        jpeg_read_header(&cinfo, TRUE);
+
+        cinfo.out_color_space = JCS_GRAYSCALE;
+        cinfo.dct_method = JDCT_IFAST;
+        cinfo.do_fancy_upsampling = FALSE;
+        cinfo.scale_num = 1;
+        cinfo.scale_denom = 1;
+        for (unsigned int denom = 8; denom > 1; denom /= 2)
+        {
+            if (cinfo.image_width / denom >= HashWidth * 4 && cinfo.image_height / denom >= HashHeight * 4)
+            {
+                cinfo.scale_denom = denom;
+                break;
+            }
+        }
+
+        jpeg_start_decompress(&cinfo);
+        image.width = static_cast<int>(cinfo.output_width);
+        image.height = static_cast<int>(cinfo.output_height);
+        image.pixels.resize(static_cast<size_t>(image.width) * image.height);
+        while (cinfo.output_scanline < cinfo.output_height)
+        {
+            JSAMPROW row = image.pixels.data() + static_cast<size_t>(cinfo.output_scanline) * image.width;
+            jpeg_read_scanlines(&cinfo, &row, 1);
+        }
+        jpeg_finish_decompress(&cinfo);
+        jpeg_destroy_decompress(&cinfo);
+        return image.width >= HashWidth && image.height >= HashHeight;
+    }
+
+    // Adds one row of 8-bit pixels into 32-bit column accumulators. This vertical pass touches every
+    // decoded pixel, so it is the part worth vectorising; the horizontal binning works on sums only
+    static void accumulateRow(const uint8_t* row, uint32_t* sums, int width)
+    {
+        int x = 0;
+#if defined(__SSE2__)
+        const __m128i zero = _mm_setzero_si128();
+        for (; x + 16 <= width; x += 16)
+        {
+            __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + x));
+            __m128i low = _mm_unpacklo_epi8(pixels, zero);
+            __m128i high = _mm_unpackhi_epi8(pixels, zero);
+
+            __m128i* out = reinterpret_cast<__m128i*>(sums + x);
+            _mm_storeu_si128(out + 0, _mm_add_epi32(_mm_loadu_si128(out + 0), _mm_unpacklo_epi16(low, zero)));
+            _mm_storeu_si128(out + 1, _mm_add_epi32(_mm_loadu_si128(out + 1), _mm_unpackhi_epi16(low, zero)));
+            _mm_storeu_si128(out + 2, _mm_add_epi32(_mm_loadu_si128(out + 2), _mm_unpacklo_epi16(high, zero)));
+            _mm_storeu_si128(out + 3, _mm_add_epi32(_mm_loadu_si128(out + 3), _mm_unpackhi_epi16(high, zero)));
+        }
+#endif
+        for (; x < width; ++x)
+        {
+            sums[x] += row[x];
+        }
+    }
+
+    // Box-filters the image down to 9x8 and builds the difference hash
+    static bool hashImage(const GreyImage& image, uint64_t& hash)
+    {
+        double cells[HashHeight][HashWidth];
+        std::vector<uint32_t> columnSums(static_cast<size_t>(image.width));
+
+        for (int cy = 0; cy < HashHeight; ++cy)
+        {
+            int y0 = cy * image.height / HashHeight;
+            int y1 = (cy + 1) * image.height / HashHeight;
+            std::fill(columnSums.begin(), columnSums.end(), 0u);
+            for (int y = y0; y < y1; ++y)
+            {
+                accumulateRow(image.pixels.data() + static_cast<size_t>(y) * image.width, columnSums.data(), image.width);
+            }
+
+            for (int cx = 0; cx < HashWidth; ++cx)
+            {
+                int x0 = cx * image.width / HashWidth;
+                int x1 = (cx + 1) * image.width / HashWidth;
+                uint64_t total = 0;
+                for (int x = x0; x < x1; ++x)
+                {
+                    total += columnSums[x];
+                }
+                cells[cy][cx] = static_cast<double>(total) / (static_cast<double>(x1 - x0) * (y1 - y0));
+            }
+        }
+
+        hash = 0;
+        for (int cy = 0; cy < HashHeight; ++cy)
+        {
+            for (int cx = 0; cx < HashWidth - 1; ++cx)
+            {
+                hash = (hash << 1) | (cells[cy][cx] < cells[cy][cx + 1] ? 1u : 0u);
+            }
+        }
+        return true;
+    }
+};
+
+// BkTree indexes 64-bit hashes under the Hamming metric. A radius query only descends into children
+// whose edge distance lies within [d - radius, d + radius], so near-duplicate lookups visit a small
+// fraction of the tree instead of comparing every pair
+class BkTree
+{
+public:
+    void insert(uint64_t hash, uint32_t id)
+    {
+        if (m_nodes.empty())
+        {
+            m_nodes.push_back({ hash, id, {} });
+            return;
+        }
+        uint32_t current = 0;
+        while (true)
+        {
+            int d = PerceptualHasher::distance(hash, m_nodes[current].hash);
+            uint32_t next = findChild(current, d);
+            if (next == NoChild)
+            {
+                m_nodes[current].children.emplace_back(d, static_cast<uint32_t>(m_nodes.size()));
+                m_nodes.push_back({ hash, id, {} });
+                return;
+            }
+            current = next;
+        }
+    }
+
+    // Calls 'visit(id, distance)' for every stored hash within 'radius' bits of 'hash'
+    template <typename Visitor>
+    void query(uint64_t hash, int radius, Visitor&& visit) const
+    {
+        if (m_nodes.empty())
+        {
+            return;
+        }
+        std::vector<uint32_t> stack{ 0 };
+        while (!stack.empty())
+        {
+            const Node& node = m_nodes[stack.back()];
+            stack.pop_back();
+            int d = PerceptualHasher::distance(hash, node.hash);
+            if (d <= radius)
+            {
+                visit(node.id, d);
+            }
+            for (const auto& child : node.children)
+            {
+                if (child.first >= d - radius && child.first <= d + radius)
+                {
+                    stack.push_back(child.second);
+                }
+            }
+        }
+    }
+
+private:
+    static constexpr uint32_t NoChild = UINT32_MAX;
+
+    struct Node
+    {
+        uint64_t hash;
+        uint32_t id;
+        std::vector<std::pair<int, uint32_t>> children;   // (edge distance, node index)
+    };
+
+    std::vector<Node> m_nodes;
+
+    uint32_t findChild(uint32_t node, int d) const
+    {
+        for (const auto& child : m_nodes[node].children)
+        {
+            if (child.first == d)
+            {
+                return child.second;
+            }
+        }
+        return NoChild;
+    }
+};
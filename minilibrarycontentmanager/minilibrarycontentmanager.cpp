@@ -8,22 +8,25 @@
 #include <unordered_map>
 #include <sstream>
 #include <string>
+#include <string_view>
 #include <cstdlib>
 #include <poll.h>
 #include <fcntl.h>
 #include <chrono>
+#include <atomic>
+#include <memory>
+#include <utility>
 
 extern "C"
 {
-    #include <sqlite3.h>
     #include <sys/inotify.h>
     #include <unistd.h>
     #include <cstring>
 }
 
-#include <taglib/fileref.h>
-#include <taglib/tag.h>
-#include <taglib/audioproperties.h>
+#include "../media_formats/audiometadata/audiometadata.h"
+#include "../sqlite/sqliteutil/connectionpool.h"
+#include "../sqlite/sqliteutil/database.h"
 
 namespace fs = std::filesystem;
 
@@ -71,6 +74,9 @@ struct MediaMetadata
     std::unordered_map<std::string, std::string> m_data;
 };
 
+// Extracted metadata on its way from the workers to the database writer
+using IngestQueue = ThreadSafeQueue<std::pair<std::string, MediaMetadata>>;
+
 //------------------------------------------------------------------------------
 // InotifyFileScanner: Uses inotify (with poll in non-blocking mode) to monitor a directory for file creation events
 class InotifyFileScanner
@@ -172,7 +178,8 @@ public:
 };
 
 //------------------------------------------------------------------------------
-// MetadataExtractorWorker: Processes file paths from the queue, extracts metadata, and stores the results
+// MetadataExtractorWorker: Processes file paths from the queue, extracts metadata, stores the results
+// and hands them on to the database writer
 class MetadataExtractorWorker
 {
 private:
@@ -180,12 +187,14 @@ private:
     std::unordered_map<std::string, MediaMetadata>& m_metadataStore;
     std::mutex& m_storeMutex;
     bool& m_scanningDone;
+    IngestQueue& m_ingestQueue;
 public:
     MetadataExtractorWorker(ThreadSafeQueue<std::string>& q,
                             std::unordered_map<std::string, MediaMetadata>& store,
                             std::mutex& mtx,
-                            bool& done)
-        : m_queue(q), m_metadataStore(store), m_storeMutex(mtx), m_scanningDone(done)
+                            bool& done,
+                            IngestQueue& ingest)
+        : m_queue(q), m_metadataStore(store), m_storeMutex(mtx), m_scanningDone(done), m_ingestQueue(ingest)
     {
     }
     void operator()()
@@ -200,35 +209,38 @@ public:
                     std::lock_guard<std::mutex> lock(m_storeMutex);
                     m_metadataStore[filepath] = meta;
                 }
+                m_ingestQueue.push({ filepath, meta });
             }
-            else if (m_queue.empty() && m_scanningDone)
+            else if (m_queue.empty() && scanningDone())
             {
                 break;
             }
         }
     }
+    bool scanningDone() const
+    {
+        std::lock_guard<std::mutex> lock(m_storeMutex);
+        return m_scanningDone;
+    }
     MediaMetadata extractMetadata(const std::string& filepath)
     {
         MediaMetadata meta;
         fs::path p(filepath);
         std::string ext = p.extension().string();
-        if (ext == ".mp3" || ext == ".wav")
+        if (audiometadata::isAudioFile(filepath))
         {
-            TagLib::FileRef file(filepath.c_str());
-            if (!file.isNull() && file.tag() && file.audioProperties())
+            AudioMetadata audio = audiometadata::extract(filepath);
+            meta.m_data["Type"] = "Audio";
+            if (audio.valid)
             {
-                auto* tag = file.tag();
-                auto* properties = file.audioProperties();
-                meta.m_data["Type"] = "Audio";
-                meta.m_data["Artist"] = tag->artist().to8Bit(true);
-                meta.m_data["Album"] = tag->album().to8Bit(true);
-                meta.m_data["Title"] = tag->title().to8Bit(true);
-                meta.m_data["Year"] = std::to_string(tag->year());
-                meta.m_data["Duration"] = std::to_string(properties->lengthInSeconds());
+                meta.m_data["Artist"] = audio.artist;
+                meta.m_data["Album"] = audio.album;
+                meta.m_data["Title"] = audio.title;
+                meta.m_data["Year"] = std::to_string(audio.year);
+                meta.m_data["Duration"] = std::to_string(audio.durationSeconds);
             }
             else
             {
-                meta.m_data["Type"] = "Audio";
                 meta.m_data["Error"] = "Metadata extraction failed";
             }
         }
@@ -256,22 +268,35 @@ public:
 };
 
 //------------------------------------------------------------------------------
-// LibraryContentManager: Coordinates scanning, metadata extraction, database storage, and custom tagging
+// LibraryContentManager: Coordinates scanning, metadata extraction, database storage, and custom tagging.
+// A scan runs in the background: m_db is the only connection that writes, fed by the extraction
+// workers, while CLI queries borrow read-only connections from m_readers. In WAL mode a reader is
+// never blocked by the writer, so queries stay quick however large the scan
 class LibraryContentManager
 {
 private:
+    static constexpr size_t ReaderConnections = 4;   // Threads that can query at once
+    static constexpr size_t IngestBatchSize = 256;   // Rows per write transaction at most
+    static constexpr size_t SearchLimit = 50;
+
     ThreadSafeQueue<std::string> m_fileQueue;
+    IngestQueue m_ingestQueue;
     std::unordered_map<std::string, MediaMetadata> m_metadataStore;
     std::unordered_map<std::string, std::vector<std::string>> m_customTags;
-    std::mutex m_storeMutex;
+    mutable std::mutex m_storeMutex;
     bool m_scanningDone { false };
-    sqlite3* m_db { nullptr };
+    Database m_db;
+    std::unique_ptr<ConnectionPool> m_readers;
+    std::thread m_ingestThread;
+    std::atomic<bool> m_ingestDone { false };
 
     void openDatabase()
     {
-        if (sqlite3_open("library.db", &m_db) != SQLITE_OK)
+        // WAL: the reader pool can read the library while a scan is writing to it
+        PragmaProfile profile = PragmaProfile::walJournal();
+        profile.busyTimeoutMs = 5000;
+        if (!m_db.open("library.db", profile))
         {
-            std::cerr << "Error opening database: " << sqlite3_errmsg(m_db) << "\n";
             exit(EXIT_FAILURE);
         }
         const char* createTableSQL =
@@ -284,90 +309,87 @@ private:
             "title TEXT, "
             "year TEXT, "
             "duration TEXT);";
-        char* errMsg = nullptr;
-        if (sqlite3_exec(m_db, createTableSQL, nullptr, nullptr, &errMsg) != SQLITE_OK)
+        if (!m_db.execute(createTableSQL))
+        {
+            exit(EXIT_FAILURE);
+        }
+        m_readers = std::make_unique<ConnectionPool>("library.db", ReaderConnections, profile);
+        if (m_readers->size() == 0)
         {
-            std::cerr << "SQL error: " << errMsg << "\n";
-            sqlite3_free(errMsg);
+            std::cerr << "Error: Could not open read-only connections to library.db\n";
             exit(EXIT_FAILURE);
         }
     }
 
+    // Stores one file's metadata through the cached statement. Paths and tags are bound, so quotes in
+    // file names or titles are stored as they are
     void insertMetadata(const std::string& filepath, const MediaMetadata& meta)
     {
-        std::string sql = "INSERT OR REPLACE INTO media_metadata (filepath, type, artist, album, title, year, duration) VALUES ("
-                          "'" + filepath + "', "
-                          "'" + (meta.m_data.count("Type") ? meta.m_data.at("Type") : "") + "', "
-                          "'" + (meta.m_data.count("Artist") ? meta.m_data.at("Artist") : "") + "', "
-                          "'" + (meta.m_data.count("Album") ? meta.m_data.at("Album") : "") + "', "
-                          "'" + (meta.m_data.count("Title") ? meta.m_data.at("Title") : "") + "', "
-                          "'" + (meta.m_data.count("Year") ? meta.m_data.at("Year") : "") + "', "
-                          "'" + (meta.m_data.count("Duration") ? meta.m_data.at("Duration") : "") + "');";
-        char* errMsg = nullptr;
-        if (sqlite3_exec(m_db, sql.c_str(), nullptr, nullptr, &errMsg) != SQLITE_OK)
-        {
-            std::cerr << "SQL error on insert: " << errMsg << "\n";
-            sqlite3_free(errMsg);
-        }
+        auto field = [&meta](const char* name) -> std::string_view
+        {
+            auto it = meta.m_data.find(name);
+            return it != meta.m_data.end() ? std::string_view(it->second) : std::string_view();
+        };
+        m_db.prepare("INSERT OR REPLACE INTO media_metadata (filepath, type, artist, album, title, year, duration) "
+                     "VALUES (?1, ?2, ?3, ?4, ?5, ?6, ?7);")
+            .bind(1, filepath).bind(2, field("Type")).bind(3, field("Artist")).bind(4, field("Album"))
+            .bind(5, field("Title")).bind(6, field("Year")).bind(7, field("Duration"))
+            .execute();
     }
 
-    void queryDatabaseImpl() const
+    // Writes metadata as the workers hand it over until 'extractionDone' is set and the queue is empty.
+    // A transaction takes whatever is queued, up to IngestBatchSize rows, so files show up in queries
+    // soon after they are extracted and no write transaction grows with the size of the scan
+    size_t storeMetadata(const std::atomic<bool>& extractionDone)
     {
-        const char* sql = "SELECT filepath, type, artist, album, title, year, duration FROM media_metadata;";
-        sqlite3_stmt* stmt;
-        if (sqlite3_prepare_v2(m_db, sql, -1, &stmt, nullptr) != SQLITE_OK)
-        {
-            std::cerr << "Failed to prepare query: " << sqlite3_errmsg(m_db) << "\n";
-            return;
-        }
-        while (sqlite3_step(stmt) == SQLITE_ROW)
-        {
-            std::cout << "File: " << reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0)) << "\n";
-            std::cout << "  Type: " << reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1)) << "\n";
-            std::cout << "  Artist: " << reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2)) << "\n";
-            std::cout << "  Album: " << reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3)) << "\n";
-            std::cout << "  Title: " << reinterpret_cast<const char*>(sqlite3_column_text(stmt, 4)) << "\n";
-            std::cout << "  Year: " << reinterpret_cast<const char*>(sqlite3_column_text(stmt, 5)) << "\n";
-            std::cout << "  Duration: " << reinterpret_cast<const char*>(sqlite3_column_text(stmt, 6)) << "\n";
-            std::cout << "---------------------------------------\n";
-        }
-        sqlite3_finalize(stmt);
-    }
-
-    void closeDatabase()
-    {
-        if (m_db)
+        size_t stored = 0;
+        std::pair<std::string, MediaMetadata> item;
+        while (true)
         {
-            sqlite3_close(m_db);
-            m_db = nullptr;
+            if (!m_ingestQueue.try_pop(item, 100))
+            {
+                if (extractionDone && m_ingestQueue.empty())
+                {
+                    break;
+                }
+                continue;
+            }
+            Transaction transaction(m_db, true);
+            size_t batch = 0;
+            do
+            {
+                insertMetadata(item.first, item.second);
+                ++batch;
+            } while (batch < IngestBatchSize && m_ingestQueue.try_pop(item, 0));
+            if (transaction.commit())
+            {
+                stored += batch;
+            }
+            else
+            {
+                std::cerr << "Could not store metadata for " << batch << " files\n";
+            }
         }
+        return stored;
     }
 
-public:
-    LibraryContentManager() { }
-
-    ~LibraryContentManager() { closeDatabase(); }
-
-    void run(const std::string& directory)
+    // Scans 'directory', extracts metadata on the worker threads and stores it. Runs on m_ingestThread
+    void ingest(const std::string& directory)
     {
-        if (!fs::exists(directory) || !fs::is_directory(directory))
-        {
-            std::cerr << "Error: Directory does not exist or is invalid.\n";
-            exit(EXIT_FAILURE);
-        }
-
-        openDatabase();
-
         InotifyFileScanner scanner(directory, m_fileQueue, &m_scanningDone);
         std::thread scannerThread(&InotifyFileScanner::start, &scanner);
 
+        std::atomic<bool> extractionDone { false };
+        size_t stored = 0;
+        std::thread writerThread([&] { stored = storeMetadata(extractionDone); });
+
         unsigned int numWorkers = std::thread::hardware_concurrency();
         if (numWorkers == 0)
             numWorkers = 2;
         std::vector<std::thread> workers;
         for (unsigned int i = 0; i < numWorkers; ++i)
         {
-            workers.emplace_back(MetadataExtractorWorker(m_fileQueue, m_metadataStore, m_storeMutex, m_scanningDone));
+            workers.emplace_back(MetadataExtractorWorker(m_fileQueue, m_metadataStore, m_storeMutex, m_scanningDone, m_ingestQueue));
         }
 
         try
@@ -383,7 +405,6 @@ public:
         catch (const fs::filesystem_error& e)
         {
             std::cerr << "Error scanning directory: " << e.what() << "\n";
-            exit(EXIT_FAILURE);
         }
 
         {
@@ -395,18 +416,75 @@ public:
         {
             worker.join();
         }
+        extractionDone = true;
+        writerThread.join();
 
-        for (const auto& pair : m_metadataStore)
+        scanner.stop();
+        scannerThread.join();
+        m_ingestDone = true;
+        std::cout << "\nScan complete: " << stored << " records stored in the database.\n> " << std::flush;
+    }
+
+    static void printRows(Statement& stmt)
+    {
+        while (stmt.step())
+        {
+            std::cout << "File: " << stmt.column<std::string_view>(0) << "\n";
+            std::cout << "  Type: " << stmt.column<std::string_view>(1) << "\n";
+            std::cout << "  Artist: " << stmt.column<std::string_view>(2) << "\n";
+            std::cout << "  Album: " << stmt.column<std::string_view>(3) << "\n";
+            std::cout << "  Title: " << stmt.column<std::string_view>(4) << "\n";
+            std::cout << "  Year: " << stmt.column<std::string_view>(5) << "\n";
+            std::cout << "  Duration: " << stmt.column<std::string_view>(6) << "\n";
+            std::cout << "---------------------------------------\n";
+        }
+    }
+
+    void closeDatabase()
+    {
+        m_readers.reset();
+        m_db.close();
+    }
+
+public:
+    LibraryContentManager() { }
+
+    ~LibraryContentManager()
+    {
+        wait();
+        closeDatabase();
+    }
+
+    // Opens the database and starts scanning 'directory' in the background
+    void start(const std::string& directory)
+    {
+        if (!fs::exists(directory) || !fs::is_directory(directory))
         {
-            insertMetadata(pair.first, pair.second);
+            std::cerr << "Error: Directory does not exist or is invalid.\n";
+            exit(EXIT_FAILURE);
         }
 
-        scanner.stop();
-        scannerThread.join();
+        openDatabase();
+        m_ingestThread = std::thread(&LibraryContentManager::ingest, this, directory);
+    }
+
+    bool scanComplete() const
+    {
+        return m_ingestDone;
+    }
+
+    // Waits for the background scan to finish
+    void wait()
+    {
+        if (m_ingestThread.joinable())
+        {
+            m_ingestThread.join();
+        }
     }
 
     void viewLibrary() const
     {
+        std::lock_guard<std::mutex> lock(m_storeMutex);
         std::cout << "\nLibrary Content Manager - Media Metadata:\n";
         for (const auto& pair : m_metadataStore)
         {
@@ -419,10 +497,25 @@ public:
         }
     }
 
-    void displayDatabase() const
+    void displayDatabase()
     {
+        ConnectionPool::Lease reader = m_readers->acquire();
+        Statement stmt = reader->prepare("SELECT filepath, type, artist, album, title, year, duration FROM media_metadata;");
         std::cout << "\nDatabase Contents:\n";
-        queryDatabaseImpl();
+        printRows(stmt);
+    }
+
+    // Lists files whose path, artist, album or title contains 'text'
+    void searchDatabase(const std::string& text)
+    {
+        ConnectionPool::Lease reader = m_readers->acquire();
+        Statement stmt = reader->prepare("SELECT filepath, type, artist, album, title, year, duration FROM media_metadata "
+                                         "WHERE filepath LIKE ?1 OR artist LIKE ?1 OR album LIKE ?1 OR title LIKE ?1 "
+                                         "ORDER BY filepath LIMIT ?2;");
+        std::string pattern = "%" + text + "%";
+        stmt.bind(1, pattern).bind(2, SearchLimit);
+        std::cout << "\nFiles matching '" << text << "' (first " << SearchLimit << "):\n";
+        printRows(stmt);
     }
 
     void addCustomTag(const std::string& filepath, const std::string& tag)
@@ -433,6 +526,7 @@ public:
 
     void viewCustomTags(const std::string& filepath) const
     {
+        std::lock_guard<std::mutex> lock(m_storeMutex);
         auto it = m_customTags.find(filepath);
         if (it != m_customTags.end())
         {
@@ -467,6 +561,7 @@ void cliInterface(LibraryContentManager& lcm)
             std::cout << "Available commands:\n";
             std::cout << "  list                : View in-memory metadata.\n";
             std::cout << "  db                  : Display database contents.\n";
+            std::cout << "  search <text>       : Find files by path, artist, album or title.\n";
             std::cout << "  tag <filepath> <tag>: Add a custom tag to a file.\n";
             std::cout << "  viewtag <filepath>  : View custom tags for a file.\n";
             std::cout << "  exit                : Exit the program.\n";
@@ -479,6 +574,19 @@ void cliInterface(LibraryContentManager& lcm)
         {
             lcm.displayDatabase();
         }
+        else if (command == "search")
+        {
+            std::string text;
+            std::getline(iss >> std::ws, text);
+            if (!text.empty())
+            {
+                lcm.searchDatabase(text);
+            }
+            else
+            {
+                std::cout << "Usage: search <text>\n";
+            }
+        }
         else if (command == "tag")
         {
             std::string filepath, tag;
@@ -508,6 +616,10 @@ void cliInterface(LibraryContentManager& lcm)
         }
         else if (command == "exit")
         {
+            if (!lcm.scanComplete())
+            {
+                std::cout << "Waiting for the scan to finish...\n";
+            }
             break;
         }
         else
@@ -525,10 +637,10 @@ int main()
     std::cout << "Enter directory to scan for media files: ";
     std::getline(std::cin, directory);
 
-    lcm.run(directory);
+    lcm.start(directory);
 
-    // Instead of printing all metadata immediately, print a summary message
-    std::cout << "\nScan complete. Records have been stored in the database.\n";
+    // The scan continues in the background; commands can be used straight away
+    std::cout << "\nScanning in the background. Records are stored in the database as they are read.\n";
     std::cout << "Enter 'help' for a list of available commands.\n";
 
     // Start CLI command loop
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <string_view>
+
+// Expense dates are stored as whole days since 1970-01-01, so they compare, index and group as plain
+// integers. These functions convert between that form and ISO "YYYY-MM-DD" text using the proleptic
+// Gregorian calendar (the conversion is Howard Hinnant's days_from_civil / civil_from_days)
+namespace expensedate
+{
+    // Days since 1970-01-01 for a calendar date
+    constexpr int64_t fromCivil(int64_t year, unsigned month, unsigned day)
+    {
+        year -= month <= 2;
+        int64_t era = (year >= 0 ? year : year - 399) / 400;
+        unsigned yearOfEra = static_cast<unsigned>(year - era * 400);
+        unsigned dayOfYear = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+        unsigned dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+        return era * 146097 + static_cast<int64_t>(dayOfEra) - 719468;
+    }
+
+    // Parses "YYYY-MM-DD" (surrounding spaces allowed). Returns false for anything else, including
+    // dates that do not exist such as 2023-02-29
+    inline bool parse(std::string_view text, int64_t& days)
+    {
+        while (!text.empty() && text.front() == ' ')
+            text.remove_prefix(1);
+        while (!text.empty() && text.back() == ' ')
+            text.remove_suffix(1);
+        if (text.size() != 10 || text[4] != '-' || text[7] != '-')
+        {
+            return false;
+        }
+        int value[3] = { 0, 0, 0 };
+        const size_t start[3] = { 0, 5, 8 };
+        const size_t length[3] = { 4, 2, 2 };
+        for (int part = 0; part < 3; ++part)
+        {
+            for (size_t i = start[part]; i < start[part] + length[part]; ++i)
+            {
+                if (text[i] < '0' || text[i] > '9')
+                {
+                    return false;
+                }
+                value[part] = value[part] * 10 + (text[i] - '0');
+            }
+        }
+
+        static constexpr unsigned char DaysInMonth[12] = { 31, 29, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+        int year = value[0], month = value[1], day = value[2];
+        bool leap = (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+        if (month < 1 || month > 12 || day < 1 || day > DaysInMonth[month - 1] || (month == 2 && day == 29 && !leap))
+        {
+            return false;
+        }
+        days = fromCivil(year, static_cast<unsigned>(month), static_cast<unsigned>(day));
+        return true;
+    }
+
+    // Calendar date for days since 1970-01-01
+    inline void toCivil(int64_t days, int64_t& year, unsigned& month, unsigned& day)
+    {
+        days += 719468;
+        int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+        unsigned dayOfEra = static_cast<unsigned>(days - era * 146097);
+        unsigned yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+        unsigned dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+        unsigned shiftedMonth = (5 * dayOfYear + 2) / 153;
+        day = dayOfYear - (153 * shiftedMonth + 2) / 5 + 1;
+        month = shiftedMonth < 10 ? shiftedMonth + 3 : shiftedMonth - 9;
+        year = static_cast<int64_t>(yearOfEra) + era * 400 + (month <= 2);
+    }
+
+    // Month of a date as the integer YYYYMM, the key of the monthly summary
+    inline int64_t monthKey(int64_t days)
+    {
+        int64_t year;
+        unsigned month, day;
+        toCivil(days, year, month, day);
+        return year * 100 + month;
+    }
+
+    // Whether a date is the first, or the last, day of its month
+    inline bool isMonthStart(int64_t days)
+    {
+        return monthKey(days - 1) != monthKey(days);
+    }
+
+    inline bool isMonthEnd(int64_t days)
+    {
+        return monthKey(days + 1) != monthKey(days);
+    }
+
+    // Formats days since 1970-01-01 as "YYYY-MM-DD"
+    inline std::string format(int64_t days)
+    {
+        int64_t year;
+        unsigned month, day;
+        toCivil(days, year, month, day);
+
+        char text[48];
+        std::snprintf(text, sizeof(text), "%04lld-%02u-%02u", static_cast<long long>(year), month, day);
+        return text;
+    }
+}
@@ -1,109 +1,728 @@
 #include <iostream>
 #include <iomanip>
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstdlib>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
 #include <string>
+#include <string_view>
+#include <vector>
 #include <sqlite3.h>
 
+#include "expensedate.h"
+#include "../sqliteutil/csvreader.h"
+#include "../sqliteutil/database.h"
+#include "../sqliteutil/tablebrowser.h"
+
+namespace fs = std::filesystem;
+
 // Represents an expense entry
 struct Expense
 {
     int id;                      // Unique identifier for the expense
-    std::string date;            // Date of the expense
+    std::string date;            // Date of the expense, as YYYY-MM-DD
     std::string category;        // Expense category
     double amount;               // Expense amount
     std::string description;     // Description of the expense
 };
 
+// Options for opening the expense database
+struct TrackerOptions
+{
+    std::string path{ "expenses.db" };      // Database file
+    PragmaProfile profile;                  // Journal, sync and cache settings (SQLite's defaults unless chosen)
+    size_t batchSize{ 50000 };              // Rows per transaction for bulk imports
+};
+
+// Inclusive range of dates for a report, in days since 1970-01-01
+struct ReportRange
+{
+    int64_t from{ INT64_MIN };
+    int64_t to{ INT64_MAX };
+};
+
 // Manages expenses by interacting with an SQLite database
 class ExpenseTracker
 {
 private:
-    sqlite3* db;  // SQLite database pointer
+    static constexpr const char* InsertSql = "INSERT INTO expenses (date, category, amount, description) VALUES (?, ?, ?, ?);";
+
+    Database db;                            // Connection and its prepared statement cache
+    size_t batchSize;
+
+    // Inserts one row through the cached statement. The values are bound, never spliced into SQL, so
+    // quotes in descriptions are stored as they are. Text is bound without copying: it only has to
+    // stay valid until the statement has been stepped
+    bool insert(int64_t date, std::string_view category, double amount, std::string_view description)
+    {
+        return db.prepare(InsertSql).bind(1, date).bind(2, category).bind(3, amount).bind(4, description).execute();
+    }
 
-    // Executes an SQL query and prints an error if it fails
-    void executeQuery(const std::string& query)
+    // Text of a column, or an empty view for NULL
+    static std::string_view columnText(sqlite3_stmt* stmt, int column)
     {
-        char* errMsg = nullptr;
-        if (sqlite3_exec(db, query.c_str(), nullptr, nullptr, &errMsg) != SQLITE_OK)
+        const char* text = reinterpret_cast<const char*>(sqlite3_column_text(stmt, column));
+        return text ? std::string_view(text, static_cast<size_t>(sqlite3_column_bytes(stmt, column))) : std::string_view();
+    }
+
+    // Parses an amount such as "12.50" or "-3". Returns false if the text is not entirely a number
+    static bool parseAmount(const std::string& text, double& amount)
+    {
+        const char* begin = text.c_str();
+        char* end = nullptr;
+        amount = std::strtod(begin, &end);
+        while (end && (*end == ' ' || *end == '\t'))
         {
-            std::cerr << "SQL error: " << errMsg << std::endl;
-            sqlite3_free(errMsg);
+            ++end;
         }
+        return end != begin && *end == '\0';
     }
 
-public:
-    // Constructor: opens the database and creates the expenses table if it doesn't exist
-    ExpenseTracker()
+    // Inserts an expense whose date is still text. Returns false (after reporting) if the date is invalid
+    bool insert(const Expense& expense)
+    {
+        int64_t date = 0;
+        if (!expensedate::parse(expense.date, date))
+        {
+            std::cerr << "Invalid date '" << expense.date << "', expected YYYY-MM-DD" << std::endl;
+            return false;
+        }
+        return insert(date, expense.category, expense.amount, expense.description);
+    }
+
+    // Reports the rows of a batch whose commit failed and was rolled back
+    static void reportLostRows(size_t rows)
+    {
+        std::cerr << "Commit failed: " << rows << " rows were rolled back and nothing after them was added" << std::endl;
+    }
+
+    // Creates the table and its indexes, converting a database with TEXT dates first. The schema
+    // version is kept in PRAGMA user_version: 0 is the original TEXT layout, 1 stores dates as days
+    // since 1970-01-01
+    void openSchema()
+    {
+        int version = 0;
+        bool exists = false;
+        {
+            Statement stmt = db.prepare("SELECT (SELECT user_version FROM pragma_user_version), "
+                                        "EXISTS (SELECT 1 FROM sqlite_master WHERE type = 'table' AND name = 'expenses');");
+            if (stmt.step())
+            {
+                version = stmt.column<int>(0);
+                exists = stmt.column<bool>(1);
+            }
+        }
+
+        const char* createTable = "CREATE TABLE IF NOT EXISTS expenses (id INTEGER PRIMARY KEY, date INTEGER, category TEXT, amount REAL, description TEXT);";
+        if (exists && version == 0)
+        {
+            // Dates that were not valid YYYY-MM-DD text become NULL. julianday() alone would roll an
+            // impossible date such as 2025-02-30 over into March, so the text must read back unchanged from
+            // its day number, which is what expensedate::parse accepts
+            std::cout << "Converting expense dates to integers..." << std::endl;
+            Transaction transaction(db);
+            bool migrated = db.execute("ALTER TABLE expenses RENAME TO expenses_text;") &&
+                            db.execute(createTable) &&
+                            db.execute("INSERT INTO expenses (id, date, category, amount, description) "
+                                       "SELECT id, CASE WHEN date(julianday(trim(date, ' '))) IS trim(date, ' ') "
+                                       "THEN CAST(julianday(trim(date, ' ')) - 2440587.5 AS INTEGER) END, "
+                                       "category, amount, description "
+                                       "FROM expenses_text;") &&
+                            db.execute("DROP TABLE expenses_text;") &&
+                            db.execute("PRAGMA user_version = 1;");
+            if (migrated)
+            {
+                transaction.commit();
+            }
+        }
+        else
+        {
+            db.execute(createTable);
+            db.execute("PRAGMA user_version = 1;");
+        }
+
+        createIndexes();
+        openSummary();
+    }
+
+    // monthly_summary holds the count and total of expenses per month (as YYYYMM) and category, kept
+    // current by triggers on every insert, update and delete, so month and category reports read a few
+    // rows per month instead of aggregating the expenses. If the triggers are missing (a new database, or
+    // an import that dropped them and did not finish) the summary cannot be trusted and is recomputed
+    void openSummary()
+    {
+        db.execute("CREATE TABLE IF NOT EXISTS monthly_summary (month INTEGER NOT NULL, category TEXT NOT NULL, "
+                     "count INTEGER NOT NULL, total REAL NOT NULL, PRIMARY KEY (month, category)) WITHOUT ROWID;");
+        if (db.queryInt("SELECT COUNT(*) FROM sqlite_master WHERE type = 'trigger' AND name IN "
+                     "('expenses_summary_insert', 'expenses_summary_delete', 'expenses_summary_update');") != 3)
+        {
+            Transaction transaction(db);
+            createSummaryTriggers();
+            rebuildSummary();
+            transaction.commit();
+        }
+    }
+
+    // Each trigger applies the change of one row to its month. Rows without a date are not summarised,
+    // and a missing category is summarised as an empty one
+    void createSummaryTriggers()
+    {
+        const std::string oldMonth = "CAST(strftime('%Y%m', OLD.date * 86400, 'unixepoch') AS INTEGER)";
+        const std::string newMonth = "CAST(strftime('%Y%m', NEW.date * 86400, 'unixepoch') AS INTEGER)";
+        const std::string add = "INSERT INTO monthly_summary (month, category, count, total) "
+                                "SELECT " + newMonth + ", COALESCE(NEW.category, ''), 1, NEW.amount WHERE NEW.date IS NOT NULL "
+                                "ON CONFLICT (month, category) DO UPDATE SET count = count + 1, total = total + excluded.total;";
+        const std::string subtract = "UPDATE monthly_summary SET count = count - 1, total = total - OLD.amount "
+                                     "WHERE month = " + oldMonth + " AND category = COALESCE(OLD.category, '');"
+                                     "DELETE FROM monthly_summary WHERE month = " + oldMonth +
+                                     " AND category = COALESCE(OLD.category, '') AND count = 0;";
+
+        db.execute("CREATE TRIGGER IF NOT EXISTS expenses_summary_insert AFTER INSERT ON expenses BEGIN " + add + " END;");
+        db.execute("CREATE TRIGGER IF NOT EXISTS expenses_summary_delete AFTER DELETE ON expenses BEGIN " + subtract + " END;");
+        db.execute("CREATE TRIGGER IF NOT EXISTS expenses_summary_update AFTER UPDATE OF date, category, amount ON expenses BEGIN " +
+                     subtract + " " + add + " END;");
+    }
+
+    void dropSummaryTriggers()
     {
-        if (sqlite3_open("expenses.db", &db) != SQLITE_OK)
+        db.execute("DROP TRIGGER IF EXISTS expenses_summary_insert; DROP TRIGGER IF EXISTS expenses_summary_delete; "
+                     "DROP TRIGGER IF EXISTS expenses_summary_update;");
+    }
+
+    // The summary as computed from scratch. Per-day groups come from idx_expenses_date in order, so the
+    // month is only derived once per day
+    static constexpr const char* RecomputedSummary =
+        "SELECT CAST(strftime('%Y%m', day * 86400, 'unixepoch') AS INTEGER) AS month, category, SUM(count) AS count, SUM(total) AS total "
+        "FROM (SELECT date AS day, COALESCE(category, '') AS category, COUNT(*) AS count, SUM(amount) AS total "
+        "FROM expenses WHERE date IS NOT NULL GROUP BY date, category) GROUP BY month, category";
+
+    void rebuildSummary()
+    {
+        db.execute("DELETE FROM monthly_summary;");
+        db.execute(std::string("INSERT INTO monthly_summary (month, category, count, total) ") + RecomputedSummary + ";");
+    }
+
+    // Both indexes carry the amount, so reports are answered from the index alone: a date range is one
+    // range scan of idx_expenses_date, a category (optionally within dates) one of idx_expenses_category
+    void createIndexes()
+    {
+        db.execute("CREATE INDEX IF NOT EXISTS idx_expenses_date ON expenses (date, category, amount);");
+        db.execute("CREATE INDEX IF NOT EXISTS idx_expenses_category ON expenses (category, date, amount);");
+    }
+
+    // Converts a range of whole months (open ends allowed) to the YYYYMM keys of the monthly summary.
+    // Returns false if either end falls inside a month
+    static bool toMonthRange(const ReportRange& range, ReportRange& months)
+    {
+        if ((range.from != INT64_MIN && !expensedate::isMonthStart(range.from)) ||
+            (range.to != INT64_MAX && !expensedate::isMonthEnd(range.to)))
         {
-            std::cerr << "Error opening database: " << sqlite3_errmsg(db) << std::endl;
+            return false;
         }
-        executeQuery("CREATE TABLE IF NOT EXISTS expenses (id INTEGER PRIMARY KEY, date TEXT, category TEXT, amount REAL, description TEXT);");
+        months.from = range.from == INT64_MIN ? INT64_MIN : expensedate::monthKey(range.from);
+        months.to = range.to == INT64_MAX ? INT64_MAX : expensedate::monthKey(range.to);
+        return true;
     }
 
-    // Destructor: closes the database
-    ~ExpenseTracker()
+    // Runs a report query with the date range bound to ?1 and ?2 (and the category to ?3, the row limit
+    // to ?4 when given), prints its rows and the time it took, and returns the number of rows.
+    // Floating-point values get two decimals
+    size_t runReport(const std::string& title, const char* sql, const ReportRange& range,
+                   const std::vector<std::string>& headers, const std::vector<int>& widths,
+                   const std::string& category = std::string(), int limit = -1)
     {
-        sqlite3_close(db);
+        Statement stmt = db.prepare(sql);
+        if (!stmt)
+        {
+            return 0;
+        }
+        stmt.bind(1, range.from).bind(2, range.to);
+        if (!category.empty())
+        {
+            stmt.bind(3, category);
+        }
+        if (limit >= 0)
+        {
+            stmt.bind(4, limit);
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        std::ostringstream out;
+        out << title << "\n";
+        for (size_t c = 0; c < headers.size(); ++c)
+        {
+            out << (c == 0 ? std::left : std::right) << std::setw(widths[c]) << headers[c] << (c + 1 < headers.size() ? "  " : "\n");
+        }
+        size_t rows = 0;
+        while (stmt.step())
+        {
+            for (int c = 0; c < static_cast<int>(headers.size()); ++c)
+            {
+                out << (c == 0 ? std::left : std::right) << std::setw(widths[c]);
+                if (sqlite3_column_type(stmt.handle(), c) == SQLITE_FLOAT)
+                {
+                    out << std::fixed << std::setprecision(2) << stmt.column<double>(c);
+                }
+                else
+                {
+                    out << stmt.column<std::string_view>(c);
+                }
+                out << (c + 1 < static_cast<int>(headers.size()) ? "  " : "\n");
+            }
+            ++rows;
+        }
+        double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::cout << out.str() << rows << " rows in " << std::fixed << std::setprecision(1) << milliseconds << " ms" << std::endl;
+        return rows;
     }
 
+public:
+    // Constructor: opens the database and creates the expenses table if it doesn't exist
+    explicit ExpenseTracker(const TrackerOptions& options = TrackerOptions()) : batchSize(options.batchSize)
+    {
+        db.open(options.path, options.profile);
+        openSchema();
+    }
+
+    ExpenseTracker(const ExpenseTracker&) = delete;
+    ExpenseTracker& operator=(const ExpenseTracker&) = delete;
+
     // Adds a new expense entry to the database
     void addExpense(const Expense& expense)
     {
-        std::string query = "INSERT INTO expenses (date, category, amount, description) VALUES ('" +
-                            expense.date + "', '" + expense.category + "', " + std::to_string(expense.amount) +
-                            ", '" + expense.description + "');";
-        executeQuery(query);
+        insert(expense);
+    }
+
+    // Adds many expenses, committing once per batch instead of once per row. A failed commit rolls its
+    // batch back and stops. Returns the number added and committed
+    size_t addExpenses(const std::vector<Expense>& expenses)
+    {
+        size_t added = 0;
+        size_t pending = 0;
+        size_t inBatch = 0;
+        Transaction transaction(db);
+        for (const auto& expense : expenses)
+        {
+            pending += insert(expense);
+            if (++inBatch == batchSize)
+            {
+                if (!transaction.commitBatch())
+                {
+                    reportLostRows(pending);
+                    return added;
+                }
+                added += pending;
+                pending = 0;
+                inBatch = 0;
+            }
+        }
+        if (!transaction.commit())
+        {
+            reportLostRows(pending);
+            return added;
+        }
+        return added + pending;
     }
 
-    // Retrieves and displays all expenses from the database in a formatted table
-    void viewExpenses()
+    // Streams expenses from a CSV file with the columns date (YYYY-MM-DD), category, amount, description
+    // (a header line is recognised and skipped). Rows are bound straight from the reader's buffers and committed in
+    // batches. Malformed rows are reported and skipped. A failed commit rolls its batch back and stops the
+    // import. Returns the number of rows imported and committed
+    size_t importCsv(const std::string& filename)
     {
-        std::string query = "SELECT * FROM expenses;";
-        sqlite3_stmt* stmt;
+        std::ifstream file(filename, std::ios::binary);
+        if (!file)
+        {
+            std::cerr << "Error opening " << filename << std::endl;
+            return 0;
+        }
+        std::vector<char> buffer(1 << 20);
+        file.rdbuf()->pubsetbuf(buffer.data(), static_cast<std::streamsize>(buffer.size()));
 
-        if (sqlite3_prepare_v2(db, query.c_str(), -1, &stmt, nullptr) == SQLITE_OK)
+        CsvReader reader(file);
+        size_t added = 0;
+        size_t pending = 0;
+        size_t skipped = 0;
+        size_t inBatch = 0;
+        bool committed = true;
+        auto start = std::chrono::steady_clock::now();
+
+        // Rows arrive in no particular category order, so keeping the indexes up to date touches pages all
+        // over them. When the file probably holds at least as many rows as the table (at roughly 32 bytes
+        // a row), it is cheaper to drop the indexes and build them once, sorted, at the end. The summary
+        // triggers go too, and the summary is recomputed from the new indexes
+        std::error_code error;
+        uintmax_t fileSize = fs::file_size(filename, error);
+        bool rebuildIndexes = !error && fileSize / 32 >= static_cast<uintmax_t>(db.queryInt("SELECT MAX(id) FROM expenses;"));
+        if (rebuildIndexes)
         {
-            // Define column widths for formatting
-            constexpr int idWidth = 6;
-            constexpr int dateWidth = 12;
-            constexpr int categoryWidth = 12;
-            constexpr int amountWidth = 8;
-            constexpr int descriptionWidth = 20;
-            // Total width accounts for columns plus separators and spaces
-            const int totalWidth = idWidth + dateWidth + categoryWidth + amountWidth + descriptionWidth + 16;
+            dropSummaryTriggers();
+            db.execute("DROP INDEX IF EXISTS idx_expenses_date; DROP INDEX IF EXISTS idx_expenses_category;");
+        }
 
-            std::cout << std::string(totalWidth, '-') << std::endl;
-            std::cout << "| " << std::setw(idWidth) << "ID" << " | "
-                      << std::setw(dateWidth) << "Date" << " | "
-                      << std::setw(categoryWidth) << "Category" << " | "
-                      << std::setw(amountWidth) << "Amount" << " | "
-                      << std::setw(descriptionWidth) << "Description" << " |" << std::endl;
-            std::cout << std::string(totalWidth, '-') << std::endl;
+        Transaction transaction(db);
+        while (reader.next())
+        {
+            if (reader.size() == 1 && reader[0].empty())
+            {
+                continue;       // Blank line
+            }
+            double amount = 0.0;
+            int64_t date = 0;
+            if (reader.size() < 3 || !parseAmount(reader[2], amount) || !expensedate::parse(reader[0], date))
+            {
+                if (reader.line() != 1)
+                {
+                    std::cerr << filename << ":" << reader.line() << ": expected YYYY-MM-DD,category,amount[,description]" << std::endl;
+                    ++skipped;
+                }
+                continue;
+            }
 
-            while (sqlite3_step(stmt) == SQLITE_ROW)
+            std::string_view description = reader.size() > 3 ? std::string_view(reader[3]) : std::string_view();
+            pending += insert(date, reader[1], amount, description);
+            if (++inBatch == batchSize)
             {
-                int id = sqlite3_column_int(stmt, 0);
-                std::string date = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
-                std::string category = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
-                double amount = sqlite3_column_double(stmt, 3);
-                std::string description = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 4));
-
-                std::cout << "| " << std::setw(idWidth) << id << " | "
-                          << std::setw(dateWidth) << date << " | "
-                          << std::setw(categoryWidth) << category << " | "
-                          << std::setw(amountWidth) << std::fixed << std::setprecision(2) << amount << " | "
-                          << std::setw(descriptionWidth) << description << " |" << std::endl;
+                committed = transaction.commitBatch();
+                if (!committed)
+                {
+                    break;
+                }
+                added += pending;
+                pending = 0;
+                inBatch = 0;
             }
-            std::cout << std::string(totalWidth, '-') << std::endl;
         }
-        sqlite3_finalize(stmt);
+        if (committed)
+        {
+            committed = transaction.commit();
+        }
+        if (committed)
+        {
+            added += pending;
+        }
+        else
+        {
+            reportLostRows(pending);
+        }
+        auto inserted = std::chrono::steady_clock::now();
+        if (rebuildIndexes)
+        {
+            createIndexes();
+            openSummary();
+        }
+
+        // The rate covers the whole import; with a rebuild, the share spent inserting is shown too
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        double insertSeconds = std::chrono::duration<double>(inserted - start).count();
+        std::cout << "Imported " << added << " expenses in " << std::fixed << std::setprecision(3) << seconds << " s ("
+                  << std::setprecision(0) << (seconds > 0 ? added / seconds : 0.0) << " rows/s";
+        if (rebuildIndexes)
+        {
+            std::cout << "; " << std::setprecision(3) << insertSeconds << " s inserting, " << seconds - insertSeconds
+                      << " s building the indexes and summary";
+        }
+        std::cout << ")";
+        if (skipped > 0)
+        {
+            std::cout << ", " << skipped << " rows skipped";
+        }
+        std::cout << std::endl;
+        return added;
+    }
+
+    // Displays the expenses a page at a time, in id order. Pages are fetched by key, so any page of a
+    // large table appears at once
+    void viewExpenses(const BrowseOptions& options = BrowseOptions())
+    {
+        TableRenderer renderer({ { "ID", true }, { "Date" }, { "Category" }, { "Amount", true }, { "Description" } }, options.format);
+        TableBrowser browser(db.handle(), "expenses", "id", "id, date, category, amount, description", renderer,
+                             [](sqlite3_stmt* stmt, TableRenderer& table)
+                             {
+                                 char amount[32];
+                                 std::snprintf(amount, sizeof(amount), "%.2f", sqlite3_column_double(stmt, 3));
+                                 table.addCell(std::to_string(sqlite3_column_int64(stmt, 0)));
+                                 table.addCell(sqlite3_column_type(stmt, 1) == SQLITE_NULL ? "" : expensedate::format(sqlite3_column_int64(stmt, 1)));
+                                 table.addCell(columnText(stmt, 2));
+                                 table.addCell(amount);
+                                 table.addCell(columnText(stmt, 4));
+                             });
+        browser.run(options);
+    }
+
+    // Totals per category, largest first. Ranges of whole months are read from the monthly summary
+    void reportByCategory(const ReportRange& range)
+    {
+        ReportRange months;
+        if (toMonthRange(range, months))
+        {
+            runReport("Expenses by category",
+                      "SELECT category, SUM(count), SUM(total) FROM monthly_summary WHERE month BETWEEN ?1 AND ?2 "
+                      "GROUP BY category ORDER BY 3 DESC;",
+                      months, { "Category", "Count", "Total" }, { 20, 10, 14 });
+            return;
+        }
+        runReport("Expenses by category",
+                  "SELECT category, COUNT(*), SUM(amount) FROM expenses WHERE date BETWEEN ?1 AND ?2 "
+                  "GROUP BY category ORDER BY 3 DESC;",
+                  range, { "Category", "Count", "Total" }, { 20, 10, 14 });
+    }
+
+    // Totals per month, for every category or just one. Ranges of whole months are read from the monthly
+    // summary. Otherwise rows are first grouped by day, which the index delivers in order without
+    // sorting, so the month is only computed once per day
+    void reportByMonth(const ReportRange& range, const std::string& category = std::string())
+    {
+        std::string title = category.empty() ? "Expenses by month" : "Expenses by month for " + category;
+        ReportRange months;
+        if (toMonthRange(range, months))
+        {
+            const char* all = "SELECT printf('%04d-%02d', month / 100, month % 100), SUM(count), SUM(total) FROM monthly_summary "
+                              "WHERE month BETWEEN ?1 AND ?2 GROUP BY month ORDER BY month;";
+            const char* oneCategory = "SELECT printf('%04d-%02d', month / 100, month % 100), count, total FROM monthly_summary "
+                                      "WHERE month BETWEEN ?1 AND ?2 AND category = ?3 ORDER BY month;";
+            runReport(title, category.empty() ? all : oneCategory, months, { "Month", "Count", "Total" }, { 10, 10, 14 }, category);
+            return;
+        }
+
+        const char* all = "SELECT strftime('%Y-%m', day * 86400, 'unixepoch') AS month, SUM(count), SUM(total) FROM "
+                          "(SELECT date AS day, COUNT(*) AS count, SUM(amount) AS total FROM expenses "
+                          "WHERE date BETWEEN ?1 AND ?2 GROUP BY date) GROUP BY month ORDER BY month;";
+        const char* oneCategory = "SELECT strftime('%Y-%m', day * 86400, 'unixepoch') AS month, SUM(count), SUM(total) FROM "
+                                  "(SELECT date AS day, COUNT(*) AS count, SUM(amount) AS total FROM expenses "
+                                  "WHERE category = ?3 AND date BETWEEN ?1 AND ?2 GROUP BY date) GROUP BY month ORDER BY month;";
+        runReport(title, category.empty() ? all : oneCategory, range, { "Month", "Count", "Total" }, { 10, 10, 14 }, category);
+    }
+
+    // The descriptions with the largest totals
+    void reportTopDescriptions(const ReportRange& range, int limit)
+    {
+        runReport("Top " + std::to_string(limit) + " descriptions",
+                  "SELECT description, COUNT(*), SUM(amount) FROM expenses WHERE date BETWEEN ?1 AND ?2 "
+                  "GROUP BY description ORDER BY 3 DESC LIMIT ?4;",
+                  range, { "Description", "Count", "Total" }, { 30, 10, 14 }, std::string(), limit);
+    }
+
+    // Daily totals with the running balance, which starts from the sum of everything before the range
+    void reportRunningBalance(const ReportRange& range)
+    {
+        runReport("Running balance",
+                  "SELECT date(date * 86400, 'unixepoch'), SUM(amount), "
+                  "SUM(SUM(amount)) OVER (ORDER BY date) + (SELECT TOTAL(amount) FROM expenses WHERE date < ?1) "
+                  "FROM expenses WHERE date BETWEEN ?1 AND ?2 GROUP BY date ORDER BY date;",
+                  range, { "Date", "Day total", "Balance" }, { 10, 14, 16 });
+    }
+
+    // Compares the monthly summary with a full recompute and lists every month and category that
+    // differs. Totals may differ in the last bits, since they were summed in a different order, so
+    // differences below a cent (or a billionth of the total) are ignored. Returns true if they agree
+    bool checkSummary()
+    {
+        std::string sql = std::string("WITH recomputed AS (") + RecomputedSummary + ") "
+            "SELECT printf('%04d-%02d', s.month / 100, s.month % 100), s.category, s.count, s.total, r.count, r.total "
+            "FROM monthly_summary s LEFT JOIN recomputed r ON r.month = s.month AND r.category = s.category "
+            "WHERE r.count IS NULL OR r.count != s.count OR ABS(r.total - s.total) > MAX(0.005, ABS(r.total) * 1e-9) "
+            "UNION ALL "
+            "SELECT printf('%04d-%02d', r.month / 100, r.month % 100), r.category, NULL, NULL, r.count, r.total FROM recomputed r "
+            "WHERE NOT EXISTS (SELECT 1 FROM monthly_summary s WHERE s.month = r.month AND s.category = r.category);";
+        size_t differences = runReport("Monthly summary differences", sql.c_str(), ReportRange(),
+                                       { "Month", "Category", "Count", "Total", "Actual count", "Actual total" },
+                                       { 8, 20, 10, 14, 12, 14 });
+        std::cout << (differences == 0 ? "Monthly summary is consistent." : "Monthly summary is inconsistent; rebuild it with --rebuild-summary.")
+                  << std::endl;
+        return differences == 0;
+    }
+
+    // Recomputes the monthly summary from the expenses
+    void repairSummary()
+    {
+        Transaction transaction(db);
+        rebuildSummary();
+        transaction.commit();
+        std::cout << "Monthly summary rebuilt." << std::endl;
     }
 };
 
-int main()
+// Prints the command line options
+void printUsage(const char* program)
 {
-    ExpenseTracker tracker;
+    std::cerr << "Usage: " << program << " [--db FILE] [--wal | --profile default|wal|fast] [--import FILE.csv [--batch ROWS]]\n"
+              << "       [--report category|month|top|balance [--from DATE] [--to DATE] [--category NAME] [--limit N]]\n"
+              << "       [--check-summary | --rebuild-summary]\n"
+              << "       [--view [--format table|csv|tsv] [--page-size N] [--after ID]]" << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+    TrackerOptions options;
+    std::string importFile;
+    std::string report;
+    bool view = false;
+    BrowseOptions browse;
+    std::string category;
+    ReportRange range;
+    int limit = 10;
+
+    // Parses a --from/--to date into 'days', or reports it
+    auto parseDate = [](const std::string& text, int64_t& days)
+    {
+        if (!expensedate::parse(text, days))
+        {
+            std::cerr << "Invalid date '" << text << "', expected YYYY-MM-DD" << std::endl;
+            return false;
+        }
+        return true;
+    };
+
+    // Parses the whole decimal number given for 'arg', from 'minimum' to 'maximum', or reports it
+    auto parseCount = [&](const std::string& arg, const char* text, unsigned long long minimum, unsigned long long maximum,
+                          unsigned long long& value)
+    {
+        char* end = nullptr;
+        errno = 0;
+        value = std::isdigit(static_cast<unsigned char>(text[0])) ? std::strtoull(text, &end, 10) : 0;
+        if (!end || *end != '\0' || errno != 0 || value < minimum || value > maximum)
+        {
+            std::cerr << "Invalid value for " << arg << ": '" << text << "'" << std::endl;
+            printUsage(argv[0]);
+            return false;
+        }
+        return true;
+    };
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--import" && i + 1 < argc)
+        {
+            importFile = argv[++i];
+        }
+        else if (arg == "--wal")
+        {
+            options.profile = PragmaProfile::walJournal();
+        }
+        else if (arg == "--profile" && i + 1 < argc)
+        {
+            if (!parsePragmaProfile(argv[++i], options.profile))
+            {
+                std::cerr << "Unknown profile '" << argv[i] << "', expected default, wal or fast" << std::endl;
+                return 1;
+            }
+        }
+        else if (arg == "--batch" && i + 1 < argc)
+        {
+            unsigned long long rows = 0;
+            if (!parseCount(arg, argv[++i], 1, SIZE_MAX, rows))
+                return 1;
+            options.batchSize = static_cast<size_t>(rows);
+        }
+        else if (arg == "--db" && i + 1 < argc)
+        {
+            options.path = argv[++i];
+        }
+        else if (arg == "--report" && i + 1 < argc)
+        {
+            report = argv[++i];
+        }
+        else if (arg == "--from" && i + 1 < argc)
+        {
+            if (!parseDate(argv[++i], range.from))
+                return 1;
+        }
+        else if (arg == "--to" && i + 1 < argc)
+        {
+            if (!parseDate(argv[++i], range.to))
+                return 1;
+        }
+        else if (arg == "--category" && i + 1 < argc)
+        {
+            category = argv[++i];
+        }
+        else if (arg == "--view")
+        {
+            view = true;
+        }
+        else if (arg == "--format" && i + 1 < argc)
+        {
+            if (!parseTableFormat(argv[++i], browse.format))
+            {
+                std::cerr << "Unknown format '" << argv[i] << "', expected table, csv or tsv" << std::endl;
+                return 1;
+            }
+            browse.interactive = browse.format == TableFormat::Table;
+        }
+        else if (arg == "--page-size" && i + 1 < argc)
+        {
+            unsigned long long rows = 0;
+            if (!parseCount(arg, argv[++i], 1, INT64_MAX, rows))
+                return 1;
+            browse.pageSize = static_cast<size_t>(rows);
+        }
+        else if (arg == "--after" && i + 1 < argc)
+        {
+            unsigned long long id = 0;
+            if (!parseCount(arg, argv[++i], 0, INT64_MAX, id))
+                return 1;
+            browse.after = static_cast<int64_t>(id);
+        }
+        else if (arg == "--check-summary" || arg == "--rebuild-summary")
+        {
+            report = arg;
+        }
+        else if (arg == "--limit" && i + 1 < argc)
+        {
+            unsigned long long rows = 0;
+            if (!parseCount(arg, argv[++i], 1, INT_MAX, rows))
+                return 1;
+            limit = static_cast<int>(rows);
+        }
+        else
+        {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    ExpenseTracker tracker(options);
+    if (!importFile.empty())
+    {
+        tracker.importCsv(importFile);
+        return 0;
+    }
+    if (view)
+    {
+        tracker.viewExpenses(browse);
+        return 0;
+    }
+    if (!report.empty())
+    {
+        if (report == "category")
+            tracker.reportByCategory(range);
+        else if (report == "month")
+            tracker.reportByMonth(range, category);
+        else if (report == "top")
+            tracker.reportTopDescriptions(range, limit);
+        else if (report == "balance")
+            tracker.reportRunningBalance(range);
+        else if (report == "--check-summary")
+            return tracker.checkSummary() ? 0 : 2;
+        else if (report == "--rebuild-summary")
+            tracker.repairSummary();
+        else
+        {
+            std::cerr << "Unknown report '" << report << "', expected category, month, top or balance" << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+
     tracker.addExpense({ 0, "2025-03-11", "Food", 15.75, "Lunch" });
     tracker.addExpense({ 0, "2025-03-11", "Transport", 10.50, "Bus fare" });
     tracker.viewExpenses();
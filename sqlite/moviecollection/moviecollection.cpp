@@ -1,8 +1,28 @@
 #include <iostream>
 #include <iomanip>
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <optional>
 #include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
 #include <sqlite3.h>
 
+#include "moviesearch.h"
+#include "../sqliteutil/csvreader.h"
+#include "../sqliteutil/database.h"
+#include "../sqliteutil/tablebrowser.h"
+
+namespace fs = std::filesystem;
+
 // Represents a movie with title, director, release year, and rating
 struct Movie
 {
@@ -13,40 +33,160 @@ struct Movie
     double rating;          // Movie rating
 };
 
+// Column of each movie field in an import file, or -1 when the file has no such column
+struct ImportColumns
+{
+    int title{ -1 };
+    int director{ -1 };
+    int year{ -1 };
+    int rating{ -1 };
+    int titleType{ -1 };    // IMDb's titleType: only rows of type "movie" are imported
+};
+
 // Manages a collection of movies stored in an SQLite database
 class MovieCollection
 {
 private:
-    sqlite3* db;  // SQLite database pointer
+    static constexpr size_t ImportBatchSize = 50000;    // Rows per transaction for bulk imports
+    static constexpr size_t ExportPageSize = 10000;     // Rows per write when exporting
+    static constexpr int ImportCacheKiB = 256 * 1024;   // Page cache during bulk imports
 
-    // Executes an SQL query and prints an error message if it fails
-    void executeQuery(const std::string& query)
+    static constexpr const char* UpsertSql =
+        "INSERT INTO movies (title, director, year, rating) VALUES (?1, ?2, ?3, ?4) "
+        "ON CONFLICT (title, COALESCE(year, -1)) DO UPDATE SET director = COALESCE(excluded.director, director), "
+        "rating = COALESCE(excluded.rating, rating);";
+
+    Database db;                                // Connection and its prepared statement cache
+    std::unique_ptr<MovieSearch> searchIndex;   // Title and director search, (re)built by the first search that needs it
+
+    // Creates the table and the unique index on title and year that identifies a movie on import. The
+    // index is on COALESCE(year, -1) because a unique index treats NULLs as distinct: movies without a
+    // year have to match each other, or every import of them would add them again. A collection from
+    // an earlier version may hold the same movie twice; those copies are merged first, keeping the one
+    // added last
+    void openSchema()
     {
-        char* errMsg = nullptr;
-        if (sqlite3_exec(db, query.c_str(), nullptr, nullptr, &errMsg) != SQLITE_OK)
+        db.execute("CREATE TABLE IF NOT EXISTS movies (id INTEGER PRIMARY KEY, title TEXT, director TEXT, year INTEGER, rating REAL);");
+        if (db.queryInt("SELECT COUNT(*) FROM sqlite_master WHERE name = 'idx_movies_title_year_key';") != 0)
         {
-            std::cerr << "SQL error: " << errMsg << std::endl;
-            sqlite3_free(errMsg);
+            return;
+        }
+
+        Transaction transaction(db);
+        db.execute("DELETE FROM movies WHERE id NOT IN (SELECT MAX(id) FROM movies GROUP BY title, COALESCE(year, -1)) "
+                   "AND title IS NOT NULL;");
+        int merged = sqlite3_changes(db.handle());
+        db.execute("DROP INDEX IF EXISTS idx_movies_title_year;");
+        db.execute("CREATE UNIQUE INDEX idx_movies_title_year_key ON movies (title, COALESCE(year, -1));");
+        transaction.commit();
+        if (merged > 0)
+        {
+            std::cout << "Merged " << merged << " duplicate movies (same title and year)" << std::endl;
         }
     }
 
-public:
-    // Constructor: Opens the database and creates the movies table if it doesn't exist
-    MovieCollection()
+    // Adds a movie, or updates the director and rating of the movie with the same title and year.
+    // Missing values (nullopt) leave the stored ones as they are. The values are bound, never spliced
+    // into SQL, so titles with quotes are stored as they are; text is bound without copying and only
+    // has to stay valid until the statement has been stepped
+    bool upsert(std::string_view title, std::optional<std::string_view> director, std::optional<int> year, std::optional<double> rating)
+    {
+        return db.prepare(UpsertSql).bind(1, title).bind(2, director).bind(3, year).bind(4, rating).execute();
+    }
+
+    // Finds the movie fields among the header names of an import file: this program's own export
+    // (title, director, year, rating) or IMDb's title.basics / title.ratings layout (primaryTitle,
+    // startYear, averageRating, ...). Returns false if there is no title column
+    static bool mapColumns(const CsvReader& header, ImportColumns& columns)
+    {
+        for (size_t i = 0; i < header.size(); ++i)
+        {
+            std::string name = header[i];
+            std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+            int column = static_cast<int>(i);
+            if (name == "title" || name == "primarytitle")
+                columns.title = column;
+            else if (name == "director" || name == "directors")
+                columns.director = column;
+            else if (name == "year" || name == "startyear")
+                columns.year = column;
+            else if (name == "rating" || name == "averagerating")
+                columns.rating = column;
+            else if (name == "titletype")
+                columns.titleType = column;
+        }
+        return columns.title >= 0;
+    }
+
+    // Field 'column' of the current record; empty, or IMDb's "\N", when missing
+    static std::string_view field(const CsvReader& reader, int column)
+    {
+        if (column < 0 || static_cast<size_t>(column) >= reader.size() || reader[column] == "\\N")
+        {
+            return std::string_view();
+        }
+        return reader[column];
+    }
+
+    // Parses a whole field as a number (a whole number for integer types). Returns false if anything
+    // but the number is in it
+    template <typename Number>
+    static bool parseNumber(std::string_view text, std::optional<Number>& value)
+    {
+        if (text.empty())
+        {
+            value.reset();
+            return true;
+        }
+        std::string copy(text);
+        char* end = nullptr;
+        double number = std::strtod(copy.c_str(), &end);
+        if (end == copy.c_str() || *end != '\0' || (std::is_integral_v<Number> && number != std::floor(number)))
+        {
+            return false;
+        }
+        value = static_cast<Number>(number);
+        return true;
+    }
+
+    // A year as shown and listed: empty when the movie has none, as exportFile() writes it, so that a
+    // listing reads back through importFile() without gaining a year 0
+    static std::string yearText(std::optional<int> year)
+    {
+        return year ? std::to_string(*year) : std::string();
+    }
+
+    // A rating with one decimal, or empty when the movie has none
+    static std::string ratingText(std::optional<double> rating)
     {
-        if (sqlite3_open("movies.db", &db) != SQLITE_OK)
+        if (!rating)
         {
-            std::cerr << "Error opening database: " << sqlite3_errmsg(db) << std::endl;
+            return std::string();
         }
-        executeQuery("CREATE TABLE IF NOT EXISTS movies (id INTEGER PRIMARY KEY, title TEXT, director TEXT, year INTEGER, rating REAL);");
+        char text[32];
+        std::snprintf(text, sizeof(text), "%.1f", *rating);
+        return text;
     }
 
-    // Destructor: Closes the SQLite database
-    ~MovieCollection()
+    // Text of a column, or an empty view for NULL
+    static std::string_view columnText(sqlite3_stmt* stmt, int column)
     {
-        sqlite3_close(db);
+        const char* text = reinterpret_cast<const char*>(sqlite3_column_text(stmt, column));
+        return text ? std::string_view(text, static_cast<size_t>(sqlite3_column_bytes(stmt, column))) : std::string_view();
     }
 
+public:
+    // Constructor: Opens the database and creates the movies table if it doesn't exist
+    explicit MovieCollection(const std::string& path = "movies.db", const PragmaProfile& profile = PragmaProfile())
+    {
+        db.open(path, profile);
+        openSchema();
+        searchIndex = std::make_unique<MovieSearch>(db);
+    }
+
+    MovieCollection(const MovieCollection&) = delete;
+    MovieCollection& operator=(const MovieCollection&) = delete;
+
     // Adds a new movie to the collection by prompting the user for input
     void addMovie()
     {
@@ -64,10 +204,170 @@ public:
         std::cin >> rating;
         std::cin.ignore();  // Clear newline left in the input buffer
 
-        std::string query = "INSERT INTO movies (title, director, year, rating) VALUES ('"
-                            + title + "', '" + director + "', " + std::to_string(year)
-                            + ", " + std::to_string(rating) + ");";
-        executeQuery(query);
+        upsert(title, std::string_view(director), year, rating);
+    }
+
+    // Streams movies from a CSV or TSV file (by extension; TSV fields are not quoted, as in IMDb's
+    // dumps). The first line names the columns, see mapColumns. Rows are bound straight from the
+    // reader's buffers and committed in batches; a movie already in the collection (same title and
+    // year) is updated rather than added twice. Malformed rows are reported and skipped. A failed
+    // commit rolls its batch back and stops the import. Returns the number of rows imported and committed
+    size_t importFile(const std::string& filename)
+    {
+        std::ifstream file(filename, std::ios::binary);
+        if (!file)
+        {
+            std::cerr << "Error opening " << filename << std::endl;
+            return 0;
+        }
+        std::vector<char> buffer(1 << 20);
+        file.rdbuf()->pubsetbuf(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+
+        bool tsv = fs::path(filename).extension() == ".tsv";
+        CsvReader reader(file, tsv ? '\t' : ',', !tsv);
+        ImportColumns columns;
+        if (!reader.next() || !mapColumns(reader, columns))
+        {
+            std::cerr << filename << ": the first line must name the columns, including title (or primaryTitle)" << std::endl;
+            return 0;
+        }
+
+        size_t added = 0;
+        size_t pending = 0;     // Rows in the open transaction
+        size_t skipped = 0;
+        size_t inBatch = 0;
+        bool committed = true;
+        auto start = std::chrono::steady_clock::now();
+
+        // Keeping the search index up to date costs more than the insert itself, so when the file
+        // probably holds at least as many movies as the table (at roughly 40 bytes a row) the index
+        // triggers are dropped and the next search rebuilds the index in one pass
+        std::error_code error;
+        uintmax_t fileSize = fs::file_size(filename, error);
+        bool rebuildIndex = !error && fileSize / 40 >= static_cast<uintmax_t>(db.queryInt("SELECT MAX(id) FROM movies;"));
+        if (rebuildIndex)
+        {
+            searchIndex->dropTriggers();
+        }
+
+        // Titles arrive in no particular order, so each insert lands on a different page of the
+        // (title, year) index. A cache large enough to hold the index keeps those pages from being
+        // written out and read back between commits
+        int64_t cacheSize = db.queryInt("PRAGMA cache_size;");
+        db.execute("PRAGMA cache_size = -" + std::to_string(ImportCacheKiB) + ";");
+
+        Transaction transaction(db);
+        while (reader.next())
+        {
+            if (reader.size() == 1 && reader[0].empty())
+            {
+                continue;       // Blank line
+            }
+            if (columns.titleType >= 0 && field(reader, columns.titleType) != "movie")
+            {
+                continue;       // IMDb series, episodes, shorts, ...
+            }
+            std::string_view title = field(reader, columns.title);
+            std::optional<int> year;
+            std::optional<double> rating;
+            if (title.empty() || !parseNumber(field(reader, columns.year), year) || !parseNumber(field(reader, columns.rating), rating))
+            {
+                std::cerr << filename << ":" << reader.line() << ": expected a title, a whole year and a numeric rating" << std::endl;
+                ++skipped;
+                continue;
+            }
+
+            std::string_view director = field(reader, columns.director);
+            pending += upsert(title, director.empty() ? std::nullopt : std::optional<std::string_view>(director), year, rating);
+            if (++inBatch == ImportBatchSize)
+            {
+                committed = transaction.commitBatch();
+                if (!committed)
+                {
+                    break;
+                }
+                added += pending;
+                pending = 0;
+                inBatch = 0;
+            }
+        }
+        if (committed)
+        {
+            committed = transaction.commit();
+        }
+        if (committed)
+        {
+            added += pending;
+        }
+        else
+        {
+            std::cerr << "Commit failed: " << pending << " rows were rolled back and the rest of " << filename
+                      << " was not imported" << std::endl;
+        }
+        db.execute("PRAGMA cache_size = " + std::to_string(cacheSize) + ";");
+
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "Imported " << added << " movies in " << std::fixed << std::setprecision(3) << seconds << " s ("
+                  << std::setprecision(0) << (seconds > 0 ? added / seconds : 0.0) << " rows/s)";
+        if (skipped > 0)
+        {
+            std::cout << ", " << skipped << " rows skipped";
+        }
+        std::cout << std::endl;
+        if (rebuildIndex)
+        {
+            std::cout << "The search index will be rebuilt by the next search." << std::endl;
+        }
+        return added;
+    }
+
+    // Writes the whole collection in id order to a CSV or TSV file (by extension) that importFile()
+    // reads back. Rows are collected and written a page at a time. Returns the number of rows written
+    size_t exportFile(const std::string& filename)
+    {
+        std::ofstream file(filename, std::ios::binary);
+        if (!file)
+        {
+            std::cerr << "Error creating " << filename << std::endl;
+            return 0;
+        }
+        std::vector<char> buffer(1 << 20);
+        file.rdbuf()->pubsetbuf(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+
+        Statement stmt = db.prepare("SELECT id, title, director, year, rating FROM movies ORDER BY id;");
+        if (!stmt)
+        {
+            return 0;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        TableFormat format = fs::path(filename).extension() == ".tsv" ? TableFormat::Tsv : TableFormat::Csv;
+        TableRenderer renderer({ { "id" }, { "title" }, { "director" }, { "year" }, { "rating" } }, format);
+        size_t written = 0;
+        while (stmt.step())
+        {
+            for (int column = 0; column < 5; ++column)
+            {
+                renderer.addCell(stmt.column<std::string_view>(column));
+            }
+            if (++written % ExportPageSize == 0)
+            {
+                renderer.flush(file);
+            }
+        }
+        if (written == 0 || renderer.rows() > 0)
+        {
+            renderer.flush(file);
+        }
+        if (!file.flush())
+        {
+            std::cerr << "Error writing " << filename << std::endl;
+        }
+
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "Exported " << written << " movies in " << std::fixed << std::setprecision(3) << seconds << " s ("
+                  << std::setprecision(0) << (seconds > 0 ? written / seconds : 0.0) << " rows/s)" << std::endl;
+        return written;
     }
 
     // Removes a movie from the collection based on the movie's ID
@@ -78,67 +378,164 @@ public:
         std::cin >> id;
         std::cin.ignore();  // Clear the input buffer
 
-        std::string query = "DELETE FROM movies WHERE id = " + std::to_string(id) + ";";
-        executeQuery(query);
+        db.prepare("DELETE FROM movies WHERE id = ?1;").bind(1, id).execute();
     }
 
-    // Retrieves and displays all movies in a formatted table
-    void viewMovies()
+    // Displays the movies a page at a time, in id order. Pages are fetched by key, so any page of a
+    // large collection appears at once
+    void viewMovies(const BrowseOptions& options = BrowseOptions())
     {
-        std::string query = "SELECT * FROM movies;";
-        sqlite3_stmt* stmt;
+        TableRenderer renderer({ { "ID", true }, { "Title" }, { "Director" }, { "Year", true }, { "Rating", true } }, options.format);
+        TableBrowser browser(db.handle(), "movies", "id", "id, title, director, year, rating", renderer,
+                             [](sqlite3_stmt* stmt, TableRenderer& table)
+                             {
+                                 bool hasYear = sqlite3_column_type(stmt, 3) != SQLITE_NULL;
+                                 bool hasRating = sqlite3_column_type(stmt, 4) != SQLITE_NULL;
+                                 table.addCell(std::to_string(sqlite3_column_int64(stmt, 0)));
+                                 table.addCell(columnText(stmt, 1));
+                                 table.addCell(columnText(stmt, 2));
+                                 table.addCell(yearText(hasYear ? std::optional<int>(sqlite3_column_int(stmt, 3)) : std::nullopt));
+                                 table.addCell(ratingText(hasRating ? std::optional<double>(sqlite3_column_double(stmt, 4)) : std::nullopt));
+                             });
+        browser.run(options);
+    }
 
-        if (sqlite3_prepare_v2(db, query.c_str(), -1, &stmt, nullptr) == SQLITE_OK)
+    // Searches titles and directors for 'query' and shows the best matches with how well they match
+    void searchMovies(const std::string& query, size_t limit = 20)
+    {
+        if (MovieSearch::length(query) < MovieSearch::MinQueryLength)
         {
-            // Define column widths for table formatting
-            constexpr int idWidth = 6;
-            constexpr int titleWidth = 25;
-            constexpr int directorWidth = 20;
-            constexpr int yearWidth = 6;
-            constexpr int ratingWidth = 8;
-            // Total width accounts for all columns and additional formatting characters
-            const int totalWidth = idWidth + titleWidth + directorWidth + yearWidth + ratingWidth + 16;
-
-            std::cout << std::string(totalWidth, '-') << std::endl;
-            std::cout << "| " << std::setw(idWidth) << "ID" << " | "
-                      << std::setw(titleWidth) << "Title" << " | "
-                      << std::setw(directorWidth) << "Director" << " | "
-                      << std::setw(yearWidth) << "Year" << " | "
-                      << std::setw(ratingWidth) << "Rating" << " |" << std::endl;
-            std::cout << std::string(totalWidth, '-') << std::endl;
+            std::cout << "Enter at least " << MovieSearch::MinQueryLength << " characters to search." << std::endl;
+            return;
+        }
 
-            while (sqlite3_step(stmt) == SQLITE_ROW)
+        auto start = std::chrono::steady_clock::now();
+        if (!searchIndex->isCurrent())
+        {
+            std::cout << "Building the search index..." << std::flush;
+            if (!searchIndex->createIndex())
             {
-                int id = sqlite3_column_int(stmt, 0);
-                std::string title = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
-                std::string director = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
-                int year = sqlite3_column_int(stmt, 3);
-                double rating = sqlite3_column_double(stmt, 4);
-
-                std::cout << "| " << std::setw(idWidth) << id << " | "
-                          << std::setw(titleWidth) << title << " | "
-                          << std::setw(directorWidth) << director << " | "
-                          << std::setw(yearWidth) << year << " | "
-                          << std::setw(ratingWidth) << std::fixed << std::setprecision(1) << rating << " |" << std::endl;
+                return;
             }
-            std::cout << std::string(totalWidth, '-') << std::endl;
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            std::cout << " done in " << std::fixed << std::setprecision(3) << seconds << " s" << std::endl;
+            start = std::chrono::steady_clock::now();
         }
-        sqlite3_finalize(stmt);
+        std::vector<SearchResult> results = searchIndex->search(query, limit);
+        double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        TableRenderer renderer({ { "ID", true }, { "Title" }, { "Director" }, { "Year", true }, { "Rating", true }, { "Match", true } },
+                               TableFormat::Table);
+        for (const auto& movie : results)
+        {
+            char match[32];
+            std::snprintf(match, sizeof(match), "%.0f%%", movie.score * 100.0);
+            renderer.addCell(std::to_string(movie.id));
+            renderer.addCell(movie.title);
+            renderer.addCell(movie.director);
+            renderer.addCell(yearText(movie.year));
+            renderer.addCell(ratingText(movie.rating));
+            renderer.addCell(match);
+        }
+        if (!results.empty())
+        {
+            renderer.flush(std::cout);
+        }
+        std::printf("%zu matches in %.1f ms\n", results.size(), milliseconds);
+        std::fflush(stdout);
+    }
+
+    // Prompts for a search
+    void searchMovies()
+    {
+        std::string query;
+        std::cout << "Search titles and directors: ";
+        std::getline(std::cin, query);
+        searchMovies(query);
     }
 };
 
-int main()
+int main(int argc, char* argv[])
 {
-    MovieCollection collection;
+    std::string path = "movies.db";
+    PragmaProfile profile;
+    std::string importPath;
+    std::string exportPath;
+    std::string query;
+    bool list = false;
+    BrowseOptions options;
+    options.interactive = false;
+    options.pageSize = 1000;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--db" && i + 1 < argc)
+        {
+            path = argv[++i];
+        }
+        else if (arg == "--profile" && i + 1 < argc)
+        {
+            if (!parsePragmaProfile(argv[++i], profile))
+            {
+                std::cerr << "Unknown profile '" << argv[i] << "', expected default, wal or fast" << std::endl;
+                return 1;
+            }
+        }
+        else if (arg == "--import" && i + 1 < argc)
+        {
+            importPath = argv[++i];
+        }
+        else if (arg == "--export" && i + 1 < argc)
+        {
+            exportPath = argv[++i];
+        }
+        else if (arg == "--search" && i + 1 < argc)
+        {
+            query = argv[++i];
+        }
+        else if (arg == "--list")
+        {
+            // "--list [table|csv|tsv]" prints the whole collection without the menu, for piping
+            list = true;
+            if (i + 1 < argc && argv[i + 1][0] != '-' && !parseTableFormat(argv[++i], options.format))
+            {
+                std::cerr << "Unknown format '" << argv[i] << "', expected table, csv or tsv" << std::endl;
+                return 1;
+            }
+        }
+        else
+        {
+            std::cerr << "Usage: " << argv[0] << " [--db FILE] [--profile default|wal|fast] [--import FILE.csv|FILE.tsv] [--export FILE.csv|FILE.tsv]\n"
+                      << "       [--list [table|csv|tsv]] [--search TEXT]" << std::endl;
+            return 1;
+        }
+    }
+
+    MovieCollection collection(path, profile);
     int choice{};
 
+    if (!importPath.empty() || !exportPath.empty() || list || !query.empty())
+    {
+        if (!importPath.empty())
+            collection.importFile(importPath);
+        if (!exportPath.empty())
+            collection.exportFile(exportPath);
+        if (list)
+            collection.viewMovies(options);
+        if (!query.empty())
+            collection.searchMovies(query);
+        return 0;
+    }
+
     while (true)
     {
         std::cout << "\nMovie Collection Manager\n";
         std::cout << "1. Add Movie\n";
         std::cout << "2. View Movies\n";
         std::cout << "3. Remove Movie\n";
-        std::cout << "4. Exit\n";
+        std::cout << "4. Search Movies\n";
+        std::cout << "5. Exit\n";
         std::cout << "Enter choice: ";
         std::cin >> choice;
         std::cin.ignore();  // Clear buffer after integer input
@@ -155,6 +552,9 @@ int main()
                 collection.removeMovie();
                 break;
             case 4:
+                collection.searchMovies();
+                break;
+            case 5:
                 return 0;
             default:
                 std::cout << "Invalid choice. Please try again.\n";
@@ -0,0 +1,355 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "../sqliteutil/database.h"
+
+// A movie found by MovieSearch, with how well it matched
+struct SearchResult
+{
+    int64_t id;
+    std::string title;
+    std::string director;
+    std::optional<int> year;        // Empty for movies without a year or rating
+    std::optional<double> rating;
+    double score;           // 1 for a substring match, otherwise the share of query trigrams found
+};
+
+// MovieSearch finds movies by title or director through an FTS5 index with the trigram tokenizer. The
+// index is external-content (it stores no copy of the text, only the trigrams) and triggers keep it
+// in step with the movies table. Trigrams are three characters, not bytes, and case and (from SQLite
+// 3.45 on) accents are folded, so "amelie" finds "Amélie".
+// A search first looks for the query as a substring, which also covers prefixes, ranked by BM25 with
+// title matches weighted above director matches. If nothing contains it, the query is treated as
+// misspelt: candidates sharing any of its rarest trigrams are fetched from the index and ranked by the
+// share of the query's trigrams they contain, so "godfahter" still finds "The Godfather"
+class MovieSearch
+{
+public:
+    static constexpr size_t MinQueryLength = 3;         // The trigram index cannot match shorter text
+    static constexpr double MinSimilarity = 0.3;        // Fuzzy matches below this are dropped
+    static constexpr size_t FuzzyCandidates = 200;      // Rows ranked in C++ for a fuzzy search
+    static constexpr size_t FuzzyTrigrams = 6;          // Rarest query trigrams used to find candidates
+    static constexpr int64_t RankedMatchLimit = 2000;   // With more matches than this, results are not ranked
+
+    explicit MovieSearch(Database& db) : m_db(db), m_removeDiacritics(sqlite3_libversion_number() >= 3045000)
+    {
+    }
+
+    MovieSearch(const MovieSearch&) = delete;
+    MovieSearch& operator=(const MovieSearch&) = delete;
+
+    // Number of characters (UTF-8 code points) in 'text', which is what MinQueryLength counts
+    static size_t length(const std::string& text)
+    {
+        return codePoints(text).size();
+    }
+
+    // True when the index exists with the current tokenizer options and its triggers keep it in step
+    // with the movies table. Otherwise createIndex() has to (re)build it before a search
+    bool isCurrent()
+    {
+        return hasCurrentTable() && m_db.queryInt("SELECT COUNT(*) FROM sqlite_master WHERE name IN "
+                                                  "('movies_fts_insert', 'movies_fts_delete', 'movies_fts_update');") == 3;
+    }
+
+    // Creates the index and its triggers if they are missing, indexing the movies already stored. An
+    // index created with other tokenizer options is dropped and rebuilt
+    bool createIndex()
+    {
+        if (isCurrent())
+        {
+            return true;
+        }
+
+        bool upToDate = hasCurrentTable();
+        Transaction transaction(m_db);
+        if (!upToDate)
+        {
+            dropTriggers();
+            m_db.execute("DROP TABLE IF EXISTS movies_fts;");
+        }
+        std::string schema =
+            "CREATE VIRTUAL TABLE IF NOT EXISTS movies_fts USING fts5(title, director, content = 'movies', content_rowid = 'id', tokenize = '" + tokenizer() + "');"
+            "CREATE TRIGGER IF NOT EXISTS movies_fts_insert AFTER INSERT ON movies BEGIN "
+            "  INSERT INTO movies_fts (rowid, title, director) VALUES (NEW.id, NEW.title, NEW.director); END;"
+            "CREATE TRIGGER IF NOT EXISTS movies_fts_delete AFTER DELETE ON movies BEGIN "
+            "  INSERT INTO movies_fts (movies_fts, rowid, title, director) VALUES ('delete', OLD.id, OLD.title, OLD.director); END;"
+            "CREATE TRIGGER IF NOT EXISTS movies_fts_update AFTER UPDATE OF title, director ON movies BEGIN "
+            "  INSERT INTO movies_fts (movies_fts, rowid, title, director) VALUES ('delete', OLD.id, OLD.title, OLD.director);"
+            "  INSERT INTO movies_fts (rowid, title, director) VALUES (NEW.id, NEW.title, NEW.director); END;"
+            "INSERT INTO movies_fts (movies_fts) VALUES ('rebuild');";
+        if (!m_db.execute(schema))
+        {
+            std::cerr << "Error creating search index" << std::endl;
+            return false;
+        }
+        return transaction.commit();
+    }
+
+    // Drops the triggers so that a bulk load does not update the index row by row. The index is stale
+    // until createIndex() rebuilds it in one pass
+    void dropTriggers()
+    {
+        m_db.execute("DROP TRIGGER IF EXISTS movies_fts_insert; DROP TRIGGER IF EXISTS movies_fts_delete; "
+                     "DROP TRIGGER IF EXISTS movies_fts_update;");
+    }
+
+    // Returns up to 'limit' movies matching 'query', best first
+    std::vector<SearchResult> search(const std::string& query, size_t limit)
+    {
+        std::vector<SearchResult> results;
+
+        // How many movies contain each trigram of the query (counted up to RankedMatchLimit), rarest
+        // first. A trigram no movie contains rules out a substring match straight away
+        std::vector<std::string> queryTrigrams = trigrams(query);
+        std::vector<std::pair<int64_t, std::string>> byFrequency;
+        bool allPresent = true;
+        for (const auto& trigram : queryTrigrams)
+        {
+            int64_t documents = countMatches(ftsString(trigram));
+            if (documents > 0)
+            {
+                byFrequency.emplace_back(documents, trigram);
+            }
+            else
+            {
+                allPresent = false;
+            }
+        }
+        std::sort(byFrequency.begin(), byFrequency.end());
+
+        // Substring match: the whole query as one FTS5 string. Ranking scores every match, so a query
+        // matching very many movies (a handful of common letters) returns the first matches unranked
+        if (allPresent && !byFrequency.empty())
+        {
+            std::string phrase = ftsString(query);
+            const char* sql = countMatches(phrase) > RankedMatchLimit ? MatchUnranked : Match;
+            collect(sql, phrase, limit, [](const SearchResult&) { return 1.0; }, results);
+            if (!results.empty())
+            {
+                return results;
+            }
+        }
+
+        // Fuzzy match: any of the query's rarest trigrams, then ranked by similarity to the query
+        if (byFrequency.empty())
+        {
+            return results;
+        }
+        byFrequency.resize(std::min(byFrequency.size(), FuzzyTrigrams));
+        std::string anyTrigram;
+        for (const auto& entry : byFrequency)
+        {
+            anyTrigram += (anyTrigram.empty() ? "" : " OR ") + ftsString(entry.second);
+        }
+        std::unordered_set<std::string> querySet(queryTrigrams.begin(), queryTrigrams.end());
+        std::vector<SearchResult> fuzzy;
+        collect(countMatches(anyTrigram) > RankedMatchLimit ? MatchUnranked : Match, anyTrigram, FuzzyCandidates,
+                [&](const SearchResult& movie) { return std::max(similarity(querySet, movie.title), similarity(querySet, movie.director)); },
+                fuzzy);
+
+        std::stable_sort(fuzzy.begin(), fuzzy.end(), [](const SearchResult& a, const SearchResult& b) { return a.score > b.score; });
+        for (auto& movie : fuzzy)
+        {
+            if (results.size() >= limit || movie.score < MinSimilarity)
+            {
+                break;
+            }
+            results.push_back(std::move(movie));
+        }
+        return results;
+    }
+
+private:
+    // Index lookups, ranked by BM25 or not. bm25() weights: a title match counts ten times a director match
+    static constexpr const char* Match =
+        "SELECT m.id, m.title, m.director, m.year, m.rating FROM movies_fts JOIN movies m ON m.id = movies_fts.rowid "
+        "WHERE movies_fts MATCH ?1 ORDER BY bm25(movies_fts, 10.0, 1.0) LIMIT ?2;";
+    static constexpr const char* MatchUnranked =
+        "SELECT m.id, m.title, m.director, m.year, m.rating FROM movies_fts JOIN movies m ON m.id = movies_fts.rowid "
+        "WHERE movies_fts MATCH ?1 LIMIT ?2;";
+
+    Database& m_db;
+    bool m_removeDiacritics;        // The tokenizer folds accents, which needs SQLite 3.45
+
+    // Options of the trigram tokenizer
+    std::string tokenizer() const
+    {
+        return m_removeDiacritics ? "trigram remove_diacritics 1" : "trigram";
+    }
+
+    // True when movies_fts exists and was created with tokenizer()
+    bool hasCurrentTable()
+    {
+        return m_db.queryInt("SELECT COUNT(*) FROM sqlite_master WHERE name = 'movies_fts' AND sql LIKE '%''" + tokenizer() + "''%';") == 1;
+    }
+
+    // Number of movies matching an FTS5 query, counting no further than RankedMatchLimit + 1 so that
+    // common terms cost no more than rare ones
+    int64_t countMatches(const std::string& match)
+    {
+        Statement stmt = m_db.prepare("SELECT COUNT(*) FROM (SELECT rowid FROM movies_fts WHERE movies_fts MATCH ?1 LIMIT ?2);");
+        stmt.bind(1, match).bind(2, RankedMatchLimit + 1);
+        return stmt.step() ? stmt.column<int64_t>(0) : 0;
+    }
+
+    // Runs a MATCH query and appends its rows, scored by 'score'
+    template <typename Score>
+    void collect(const char* sql, const std::string& match, size_t limit, Score score, std::vector<SearchResult>& results)
+    {
+        Statement stmt = m_db.prepare(sql);
+        stmt.bind(1, match).bind(2, limit);
+        while (stmt.step())
+        {
+            SearchResult movie{ stmt.column<int64_t>(0), stmt.column<std::string>(1), stmt.column<std::string>(2),
+                                stmt.column<std::optional<int>>(3), stmt.column<std::optional<double>>(4), 0.0 };
+            movie.score = score(movie);
+            results.push_back(std::move(movie));
+        }
+    }
+
+    // 'text' as an FTS5 string literal, which the trigram tokenizer matches as a substring
+    static std::string ftsString(const std::string& text)
+    {
+        std::string quoted = "\"";
+        for (char c : text)
+        {
+            quoted += c;
+            if (c == '"')
+                quoted += '"';
+        }
+        return quoted + "\"";
+    }
+
+    // The code points of UTF-8 'text'. A byte that does not start a valid sequence stands for itself,
+    // mapped to U+DC80-U+DCFF so that it cannot be mistaken for a character
+    static std::vector<char32_t> codePoints(const std::string& text)
+    {
+        std::vector<char32_t> result;
+        result.reserve(text.size());
+        for (size_t i = 0; i < text.size();)
+        {
+            unsigned char lead = static_cast<unsigned char>(text[i]);
+            size_t length = lead < 0x80 ? 1 : lead >= 0xC2 && lead < 0xE0 ? 2 : lead >= 0xE0 && lead < 0xF0 ? 3 : lead >= 0xF0 && lead < 0xF5 ? 4 : 0;
+            char32_t c = length == 1 ? lead : length == 2 ? lead & 0x1F : length == 3 ? lead & 0x0F : lead & 0x07;
+            size_t next = 1;
+            while (next < length && i + next < text.size() && (static_cast<unsigned char>(text[i + next]) & 0xC0) == 0x80)
+            {
+                c = (c << 6) | (static_cast<unsigned char>(text[i + next]) & 0x3F);
+                ++next;
+            }
+            if (length == 0 || next < length)
+            {
+                result.push_back(0xDC00 + lead);
+                ++i;
+                continue;
+            }
+            result.push_back(c);
+            i += length;
+        }
+        return result;
+    }
+
+    // Folds a code point as the trigram tokenizer does: upper case to lower case (Latin, Greek and
+    // Cyrillic) and, with remove_diacritics, accented Latin letters to their base letter
+    static char32_t fold(char32_t c, bool removeDiacritics)
+    {
+        // Base letters of U+00C0 to U+017F, '.' where there is none
+        static constexpr char Latin[] =
+            "aaaaaa.ceeeeiiii.nooooo..uuuuy.." "aaaaaa.ceeeeiiii.nooooo..uuuuy.y"
+            "aaaaaaccccccccddddeeeeeeeeeegggggggghhhhiiiiiiiiii..jjkk.llllllllllnnnnnn...oooooo..rrrrrrsssssssstttttt"
+            "uuuuuuuuuuuuwwyyyzzzzzzs";
+        static_assert(sizeof(Latin) - 1 == 0x180 - 0xC0, "one entry per code point");
+        if (c < 0x80)
+        {
+            return c >= 'A' && c <= 'Z' ? c + 0x20 : c;
+        }
+        if (c >= 0xC0 && c < 0x180)
+        {
+            if (removeDiacritics && Latin[c - 0xC0] != '.')
+                return static_cast<char32_t>(Latin[c - 0xC0]);
+            if (c <= 0xDE && c != 0xD7)
+                return c + 0x20;
+            if (c >= 0x100 && c <= 0x177 && c != 0x130 && c != 0x131 && c != 0x138 && c != 0x149)
+                return (c >= 0x139 && c <= 0x148) ? c + (c & 1) : c | 1;
+            return c == 0x178 ? 0xFF : c >= 0x179 && c <= 0x17E ? c + (c & 1) : c == 0x130 ? 'i' : c;
+        }
+        if ((c >= 0x391 && c <= 0x3A9) || (c >= 0x410 && c <= 0x42F))
+        {
+            return c + 0x20;
+        }
+        return c >= 0x400 && c <= 0x40F ? c + 0x50 : c;
+    }
+
+    // 'c' encoded as UTF-8
+    static void appendUtf8(std::string& out, char32_t c)
+    {
+        if (c < 0x80)
+        {
+            out += static_cast<char>(c);
+        }
+        else if (c < 0x800)
+        {
+            out += static_cast<char>(0xC0 | (c >> 6));
+            out += static_cast<char>(0x80 | (c & 0x3F));
+        }
+        else if (c < 0x10000)
+        {
+            out += static_cast<char>(0xE0 | (c >> 12));
+            out += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (c & 0x3F));
+        }
+        else
+        {
+            out += static_cast<char>(0xF0 | (c >> 18));
+            out += static_cast<char>(0x80 | ((c >> 12) & 0x3F));
+            out += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (c & 0x3F));
+        }
+    }
+
+    // Distinct folded trigrams of 'text', three characters each as the trigram tokenizer cuts them
+    std::vector<std::string> trigrams(const std::string& text) const
+    {
+        std::vector<std::string> characters;
+        for (char32_t c : codePoints(text))
+        {
+            characters.emplace_back();
+            appendUtf8(characters.back(), fold(c, m_removeDiacritics));
+        }
+        std::vector<std::string> result;
+        std::unordered_set<std::string> seen;
+        for (size_t i = 0; i + 3 <= characters.size(); ++i)
+        {
+            std::string trigram = characters[i] + characters[i + 1] + characters[i + 2];
+            if (seen.insert(trigram).second)
+            {
+                result.push_back(std::move(trigram));
+            }
+        }
+        return result;
+    }
+
+    // Share of the query's trigrams that occur in 'text'. Extra words in the text cost nothing, so a
+    // misspelt word scores the same in a long title as in a short one
+    double similarity(const std::unordered_set<std::string>& query, const std::string& text) const
+    {
+        if (query.empty())
+        {
+            return 0.0;
+        }
+        size_t shared = 0;
+        for (const auto& trigram : trigrams(text))
+        {
+            shared += query.count(trigram);
+        }
+        return static_cast<double>(shared) / static_cast<double>(query.size());
+    }
+};
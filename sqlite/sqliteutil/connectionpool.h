@@ -0,0 +1,102 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "database.h"
+
+// ConnectionPool keeps a fixed number of read-only connections to a database in WAL mode, for
+// threads that query while another connection writes. In WAL mode a reader sees the last commit
+// made before its query started and neither waits for the writer nor holds it up, so a long import
+// does not stall interactive queries. A connection (with its own statement cache) is lent to one
+// thread at a time; when all are lent, acquire() waits for one to come back.
+// The writer must have switched the file to WAL before the pool opens: the journal mode is stored
+// in the database and read-only connections cannot change it
+class ConnectionPool
+{
+public:
+    // Lends one connection until it goes out of scope
+    class Lease
+    {
+    public:
+        Lease(ConnectionPool& pool, Database* db) : m_pool(pool), m_db(db)
+        {
+        }
+
+        Lease(Lease&& other) noexcept : m_pool(other.m_pool), m_db(std::exchange(other.m_db, nullptr))
+        {
+        }
+
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+        Lease& operator=(Lease&&) = delete;
+
+        ~Lease()
+        {
+            if (m_db)
+            {
+                m_pool.release(m_db);
+            }
+        }
+
+        Database& db() const { return *m_db; }
+        Database* operator->() const { return m_db; }
+
+    private:
+        ConnectionPool& m_pool;
+        Database* m_db;
+    };
+
+    // Opens 'size' read-only connections to 'path'. The profile's cache, mmap and busy timeout apply
+    // to each connection; its journal setting is ignored (see above)
+    ConnectionPool(const std::string& path, size_t size, PragmaProfile profile = PragmaProfile())
+    {
+        profile.wal = false;
+        for (size_t i = 0; i < std::max<size_t>(size, 1); ++i)
+        {
+            auto db = std::make_unique<Database>();
+            // NOMUTEX: a connection is only ever used by the thread holding its lease
+            if (db->open(path, profile, SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX))
+            {
+                m_idle.push_back(db.get());
+                m_connections.push_back(std::move(db));
+            }
+        }
+    }
+
+    ConnectionPool(const ConnectionPool&) = delete;
+    ConnectionPool& operator=(const ConnectionPool&) = delete;
+
+    // Number of connections that opened
+    size_t size() const { return m_connections.size(); }
+
+    // Waits for an idle connection and lends it. The pool must have at least one connection
+    Lease acquire()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_returned.wait(lock, [this] { return !m_idle.empty(); });
+        Database* db = m_idle.back();
+        m_idle.pop_back();
+        return Lease(*this, db);
+    }
+
+private:
+    std::vector<std::unique_ptr<Database>> m_connections;
+    std::vector<Database*> m_idle;
+    std::mutex m_mutex;
+    std::condition_variable m_returned;
+
+    void release(Database* db)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_idle.push_back(db);
+        }
+        m_returned.notify_one();
+    }
+};
@@ -0,0 +1,259 @@
+#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "connectionpool.h"
+#include "database.h"
+#include "tablerenderer.h"
+
+namespace fs = std::filesystem;
+
+// Measures query latency while a writer ingests rows, in two set-ups:
+// - shared: one connection with SQLite's default journal, shared by the writer and the query threads
+//   behind a mutex, so a query waits for any write transaction in progress
+// - pool: a WAL writer connection and a ConnectionPool of read-only connections for the query threads
+// Each set-up is measured idle and then during ingest. With the pool, latency during ingest should
+// stay close to the idle figures
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    const char* Schema = "CREATE TABLE IF NOT EXISTS library (id INTEGER PRIMARY KEY, filepath TEXT UNIQUE, artist TEXT, title TEXT);";
+    const char* Insert = "INSERT OR REPLACE INTO library (filepath, artist, title) VALUES (?1, ?2, ?3);";
+    const char* Lookup = "SELECT artist, title FROM library WHERE filepath = ?1;";
+    const char* Recent = "SELECT filepath, artist, title FROM library ORDER BY id DESC LIMIT 50;";
+
+    struct Settings
+    {
+        std::string path{ "connectionpoolbench.db" };
+        size_t rows{ 200000 };          // Rows ingested while queries run
+        size_t batch{ 5000 };           // Rows per write transaction
+        size_t threads{ 4 };            // Query threads (and pooled connections)
+        int idleMs{ 1000 };             // Length of the idle measurement
+    };
+
+    // Latency percentiles in milliseconds
+    struct Latency
+    {
+        size_t queries{ 0 };
+        double p50{ 0 };
+        double p99{ 0 };
+        double max{ 0 };
+    };
+
+    Latency summarise(std::vector<double>& samples)
+    {
+        Latency latency;
+        latency.queries = samples.size();
+        if (samples.empty())
+        {
+            return latency;
+        }
+        std::sort(samples.begin(), samples.end());
+        latency.p50 = samples[samples.size() / 2];
+        latency.p99 = samples[std::min(samples.size() - 1, samples.size() * 99 / 100)];
+        latency.max = samples.back();
+        return latency;
+    }
+
+    std::string filepath(size_t index)
+    {
+        char text[64];
+        std::snprintf(text, sizeof(text), "/music/artist-%04zu/track-%08zu.mp3", index % 1000, index);
+        return text;
+    }
+
+    // One query as the CLI would run it: a lookup by path, then the most recent additions
+    void runQuery(Database& db, std::mt19937_64& random, size_t knownRows)
+    {
+        std::string path = filepath(random() % knownRows);
+        {
+            Statement stmt = db.prepare(Lookup);
+            stmt.bind(1, path);
+            stmt.step();
+        }
+        Statement stmt = db.prepare(Recent);
+        while (stmt.step())
+        {
+        }
+    }
+
+    // Inserts rows [first, first + count) in transactions of 'batch' rows. 'lock' is held for each
+    // transaction when the connection is shared
+    template <typename Lock>
+    double ingest(Database& db, size_t first, size_t count, size_t batch, Lock lock)
+    {
+        auto start = Clock::now();
+        for (size_t done = 0; done < count;)
+        {
+            auto guard = lock();
+            Transaction transaction(db);
+            for (size_t end = std::min(count, done + batch); done < end; ++done)
+            {
+                std::string path = filepath(first + done);
+                db.prepare(Insert).bind(1, path).bind(2, "Artist").bind(3, "Title").execute();
+            }
+            transaction.commit();
+        }
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        return seconds > 0 ? static_cast<double>(count) / seconds : 0.0;
+    }
+
+    // Runs the query threads until 'stop' is set and returns every query's latency. 'query' runs one
+    // query on whatever connection the set-up provides
+    template <typename Query>
+    std::vector<double> measure(size_t threads, std::atomic<bool>& stop, Query query)
+    {
+        std::vector<std::vector<double>> samples(threads);
+        std::vector<std::thread> workers;
+        for (size_t t = 0; t < threads; ++t)
+        {
+            workers.emplace_back([&, t]
+            {
+                std::mt19937_64 random(t);
+                while (!stop)
+                {
+                    auto start = Clock::now();
+                    query(random);
+                    samples[t].push_back(std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));      // A user does not query flat out
+                }
+            });
+        }
+        for (auto& worker : workers)
+        {
+            worker.join();
+        }
+        std::vector<double> all;
+        for (auto& some : samples)
+        {
+            all.insert(all.end(), some.begin(), some.end());
+        }
+        return all;
+    }
+
+    void removeDatabase(const std::string& path)
+    {
+        std::error_code error;
+        for (const char* suffix : { "", "-wal", "-shm", "-journal" })
+        {
+            fs::remove(path + suffix, error);
+        }
+    }
+
+    std::string format(double value, const char* pattern)
+    {
+        char text[32];
+        std::snprintf(text, sizeof(text), pattern, value);
+        return text;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    Settings settings;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--rows" && i + 1 < argc)
+            settings.rows = std::max<size_t>(1000, std::stoul(argv[++i]));
+        else if (arg == "--batch" && i + 1 < argc)
+            settings.batch = std::max<size_t>(1, std::stoul(argv[++i]));
+        else if (arg == "--threads" && i + 1 < argc)
+            settings.threads = std::max<size_t>(1, std::stoul(argv[++i]));
+        else if (arg == "--db" && i + 1 < argc)
+            settings.path = argv[++i];
+        else
+        {
+            std::cerr << "Usage: " << argv[0] << " [--rows N] [--batch N] [--threads N] [--db FILE]" << std::endl;
+            return 1;
+        }
+    }
+
+    const size_t SeedRows = 50000;      // Rows present before any measurement
+    TableRenderer results({ { "Set-up" }, { "Phase" }, { "Queries", true }, { "p50 ms", true }, { "p99 ms", true },
+                            { "Max ms", true }, { "Ingest rows/s", true } },
+                          TableFormat::Table);
+    auto report = [&](const char* setup, const char* phase, std::vector<double>& samples, double ingestRate)
+    {
+        Latency latency = summarise(samples);
+        results.addCell(setup);
+        results.addCell(phase);
+        results.addCell(std::to_string(latency.queries));
+        results.addCell(format(latency.p50, "%.3f"));
+        results.addCell(format(latency.p99, "%.3f"));
+        results.addCell(format(latency.max, "%.3f"));
+        results.addCell(ingestRate > 0 ? format(ingestRate, "%.0f") : "-");
+    };
+
+    for (bool pooled : { false, true })
+    {
+        const char* setup = pooled ? "pool" : "shared";
+        std::cout << "Set-up " << setup << "..." << std::endl;
+        removeDatabase(settings.path);
+
+        PragmaProfile profile = pooled ? PragmaProfile::walJournal() : PragmaProfile::defaults();
+        profile.busyTimeoutMs = 5000;
+        Database writer(settings.path, profile);
+        writer.execute(Schema);
+        ingest(writer, 0, SeedRows, settings.batch, [] { return std::unique_lock<std::mutex>(); });
+
+        std::unique_ptr<ConnectionPool> pool;
+        std::mutex shared;
+        if (pooled)
+        {
+            pool = std::make_unique<ConnectionPool>(settings.path, settings.threads, profile);
+        }
+        auto query = [&](std::mt19937_64& random)
+        {
+            if (pooled)
+            {
+                ConnectionPool::Lease lease = pool->acquire();
+                runQuery(lease.db(), random, SeedRows);
+            }
+            else
+            {
+                std::lock_guard<std::mutex> lock(shared);
+                runQuery(writer, random, SeedRows);
+            }
+        };
+        auto lockWrites = [&]
+        {
+            return pooled ? std::unique_lock<std::mutex>() : std::unique_lock<std::mutex>(shared);
+        };
+
+        std::atomic<bool> stop{ false };
+        std::thread timer([&] { std::this_thread::sleep_for(std::chrono::milliseconds(settings.idleMs)); stop = true; });
+        std::vector<double> idle = measure(settings.threads, stop, query);
+        timer.join();
+        report(setup, "idle", idle, 0.0);
+
+        stop = false;
+        double ingestRate = 0.0;
+        std::thread writerThread([&]
+        {
+            ingestRate = ingest(writer, SeedRows, settings.rows, settings.batch, lockWrites);
+            stop = true;
+        });
+        std::vector<double> busy = measure(settings.threads, stop, query);
+        writerThread.join();
+        report(setup, "ingest", busy, ingestRate);
+
+        pool.reset();
+        writer.close();
+        removeDatabase(settings.path);
+    }
+
+    std::cout << "\n" << settings.threads << " query threads, " << settings.rows << " rows ingested in batches of " << settings.batch << "\n";
+    results.flush(std::cout);
+    return 0;
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <istream>
+#include <string>
+#include <vector>
+
+// CsvReader streams records from delimited text (RFC 4180 CSV, or TSV with a tab delimiter). Quoted
+// fields may contain delimiters, doubled quotes and line breaks. Only one record is held in memory,
+// and the field strings are reused from record to record, so reading does not allocate per row.
+// With 'quoting' off every character is literal, as in IMDb's TSV dumps where titles contain bare quotes
+class CsvReader
+{
+public:
+    explicit CsvReader(std::istream& in, char delimiter = ',', bool quoting = true)
+        : m_in(in), m_delimiter(delimiter), m_quoting(quoting)
+    {
+    }
+
+    // Reads the next record. Returns false at the end of the input
+    bool next()
+    {
+        m_count = 0;
+        if (!std::getline(m_in, m_line))
+        {
+            return false;
+        }
+        ++m_lineNumber;
+        m_recordLine = m_lineNumber;
+
+        std::string* field = &nextField();
+        bool quoted = false;
+        for (size_t i = 0;; ++i)
+        {
+            if (i == m_line.size())
+            {
+                // A quoted field runs on into the next line
+                if (quoted && std::getline(m_in, m_line))
+                {
+                    ++m_lineNumber;
+                    field->push_back('\n');
+                    i = static_cast<size_t>(-1);
+                    continue;
+                }
+                break;
+            }
+
+            char c = m_line[i];
+            if (quoted)
+            {
+                if (c != '"')
+                {
+                    field->push_back(c);
+                }
+                else if (i + 1 < m_line.size() && m_line[i + 1] == '"')
+                {
+                    field->push_back('"');
+                    ++i;
+                }
+                else
+                {
+                    quoted = false;
+                }
+            }
+            else if (c == m_delimiter)
+            {
+                field = &nextField();
+            }
+            else if (c == '"' && m_quoting && field->empty())
+            {
+                quoted = true;
+            }
+            else if (c != '\r' || i + 1 != m_line.size())
+            {
+                field->push_back(c);
+            }
+        }
+        return true;
+    }
+
+    size_t size() const { return m_count; }
+    const std::string& operator[](size_t index) const { return m_fields[index]; }
+
+    // Line on which the current record starts, counting from 1
+    size_t line() const { return m_recordLine; }
+
+private:
+    std::istream& m_in;
+    char m_delimiter;
+    bool m_quoting;
+    std::string m_line;
+    std::vector<std::string> m_fields;
+    size_t m_count{ 0 };
+    size_t m_lineNumber{ 0 };
+    size_t m_recordLine{ 0 };
+
+    std::string& nextField()
+    {
+        if (m_count == m_fields.size())
+        {
+            m_fields.emplace_back();
+        }
+        std::string& field = m_fields[m_count++];
+        field.clear();
+        return field;
+    }
+};
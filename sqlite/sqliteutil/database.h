@@ -0,0 +1,504 @@
+#pragma once
+
+#include <cstdint>
+#include <iostream>
+#include <list>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+extern "C"
+{
+    #include <sqlite3.h>
+}
+
+// Connection settings applied when a Database is opened. A field left at its default keeps SQLite's
+// own default, so PragmaProfile() is a bare sqlite3_open: rollback journal, synchronous=FULL and a
+// 2 MB page cache
+struct PragmaProfile
+{
+    std::string name{ "default" };
+    bool wal{ false };              // journal_mode=WAL with synchronous=NORMAL: readers do not block the writer
+                                    // and commits are synced at checkpoints instead of every time
+    int64_t mmapSize{ 0 };          // Bytes of the file read through mmap instead of read() (0 = off)
+    int64_t cacheKiB{ 0 };          // Page cache per connection in KiB (0 = SQLite's default)
+    bool tempInMemory{ false };     // temp_store=MEMORY: sorts and temporary indexes never touch disk
+    int busyTimeoutMs{ 0 };         // How long to wait for another connection's lock before failing with SQLITE_BUSY
+
+    static PragmaProfile defaults()
+    {
+        return PragmaProfile();
+    }
+
+    // WAL alone: the cheapest durable setting for a program that commits often. A power loss can undo
+    // the latest commits but cannot corrupt the database
+    static PragmaProfile walJournal()
+    {
+        PragmaProfile profile;
+        profile.name = "wal";
+        profile.wal = true;
+        return profile;
+    }
+
+    // WAL with a 64 MB cache and 256 MB of memory-mapped reads, for bulk loads and reports over large
+    // tables. temp_store stays on its default: keeping sorts in memory measured slower (see databasebench)
+    static PragmaProfile fast()
+    {
+        PragmaProfile profile = walJournal();
+        profile.name = "fast";
+        profile.mmapSize = 256LL << 20;
+        profile.cacheKiB = 64 * 1024;
+        return profile;
+    }
+
+    static std::vector<PragmaProfile> all()
+    {
+        return { defaults(), walJournal(), fast() };
+    }
+};
+
+// Parses "default", "wal" or "fast". Returns false for anything else
+inline bool parsePragmaProfile(const std::string& text, PragmaProfile& profile)
+{
+    for (const auto& candidate : PragmaProfile::all())
+    {
+        if (candidate.name == text)
+        {
+            profile = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+// A prepared statement borrowed from a Database's statement cache. Values are bound by position
+// (from 1) and columns read by position (from 0) with the type chosen by the template argument.
+// When the handle goes out of scope the statement is reset, its bindings cleared and it returns to
+// the cache. Text is bound without copying, so it must stay valid until the statement has been
+// stepped. A Statement must not outlive its Database
+class Statement
+{
+public:
+    Statement() = default;
+
+    Statement(sqlite3_stmt* stmt, bool* inUse, bool owned) : m_stmt(stmt), m_inUse(inUse), m_owned(owned)
+    {
+    }
+
+    Statement(Statement&& other) noexcept
+        : m_stmt(std::exchange(other.m_stmt, nullptr)), m_inUse(std::exchange(other.m_inUse, nullptr)), m_owned(other.m_owned)
+    {
+    }
+
+    Statement& operator=(Statement&& other) noexcept
+    {
+        if (this != &other)
+        {
+            release();
+            m_stmt = std::exchange(other.m_stmt, nullptr);
+            m_inUse = std::exchange(other.m_inUse, nullptr);
+            m_owned = other.m_owned;
+        }
+        return *this;
+    }
+
+    Statement(const Statement&) = delete;
+    Statement& operator=(const Statement&) = delete;
+
+    ~Statement()
+    {
+        release();
+    }
+
+    // False if the statement failed to prepare
+    explicit operator bool() const { return m_stmt != nullptr; }
+
+    sqlite3_stmt* handle() const { return m_stmt; }
+
+    // Binds integers, floating-point numbers, text (std::string, std::string_view, const char*),
+    // nullptr for NULL, or a std::optional of any of these (NULL when empty)
+    template <typename T>
+    Statement& bind(int index, const T& value)
+    {
+        if (!m_stmt)
+        {
+            return *this;
+        }
+        if constexpr (std::is_same_v<T, std::nullptr_t>)
+        {
+            sqlite3_bind_null(m_stmt, index);
+        }
+        else if constexpr (IsOptional<T>::value)
+        {
+            if (value)
+                bind(index, *value);
+            else
+                sqlite3_bind_null(m_stmt, index);
+        }
+        else if constexpr (std::is_integral_v<T>)
+        {
+            sqlite3_bind_int64(m_stmt, index, static_cast<sqlite3_int64>(value));
+        }
+        else if constexpr (std::is_floating_point_v<T>)
+        {
+            sqlite3_bind_double(m_stmt, index, static_cast<double>(value));
+        }
+        else
+        {
+            std::string_view text(value);
+            sqlite3_bind_text(m_stmt, index, text.data(), static_cast<int>(text.size()), SQLITE_STATIC);
+        }
+        return *this;
+    }
+
+    // Steps to the next row. Returns false when there are no more rows, reporting any error
+    bool step()
+    {
+        if (!m_stmt)
+        {
+            return false;
+        }
+        int result = sqlite3_step(m_stmt);
+        if (result != SQLITE_ROW && result != SQLITE_DONE)
+        {
+            std::cerr << "SQL error: " << sqlite3_errmsg(sqlite3_db_handle(m_stmt)) << std::endl;
+        }
+        return result == SQLITE_ROW;
+    }
+
+    // Runs a statement that returns no rows, then resets it (keeping the bindings) so it can be run
+    // again. Returns false, after reporting, if it fails
+    bool execute()
+    {
+        if (!m_stmt)
+        {
+            return false;
+        }
+        int result = sqlite3_step(m_stmt);
+        while (result == SQLITE_ROW)
+        {
+            result = sqlite3_step(m_stmt);
+        }
+        if (result != SQLITE_DONE)
+        {
+            std::cerr << "SQL error: " << sqlite3_errmsg(sqlite3_db_handle(m_stmt)) << std::endl;
+        }
+        sqlite3_reset(m_stmt);
+        return result == SQLITE_DONE;
+    }
+
+    // Rewinds the statement so that it can be stepped again with new bindings
+    void reset()
+    {
+        if (m_stmt)
+        {
+            sqlite3_reset(m_stmt);
+        }
+    }
+
+    bool isNull(int column) const { return sqlite3_column_type(m_stmt, column) == SQLITE_NULL; }
+
+    // Reads a column of the current row as an integer, floating-point number, std::string_view (valid
+    // until the next step), std::string, or a std::optional of these that is empty for NULL
+    template <typename T>
+    T column(int column) const
+    {
+        if constexpr (IsOptional<T>::value)
+        {
+            if (isNull(column))
+                return std::nullopt;
+            return this->column<typename T::value_type>(column);
+        }
+        else if constexpr (std::is_integral_v<T>)
+        {
+            return static_cast<T>(sqlite3_column_int64(m_stmt, column));
+        }
+        else if constexpr (std::is_floating_point_v<T>)
+        {
+            return static_cast<T>(sqlite3_column_double(m_stmt, column));
+        }
+        else
+        {
+            const char* text = reinterpret_cast<const char*>(sqlite3_column_text(m_stmt, column));
+            return text ? T(text, static_cast<size_t>(sqlite3_column_bytes(m_stmt, column))) : T();
+        }
+    }
+
+private:
+    template <typename T>
+    struct IsOptional : std::false_type
+    {
+    };
+
+    template <typename T>
+    struct IsOptional<std::optional<T>> : std::true_type
+    {
+    };
+
+    sqlite3_stmt* m_stmt{ nullptr };
+    bool* m_inUse{ nullptr };
+    bool m_owned{ false };      // Prepared outside the cache, finalized on release
+
+    void release()
+    {
+        if (!m_stmt)
+        {
+            return;
+        }
+        if (m_owned)
+        {
+            sqlite3_finalize(m_stmt);
+        }
+        else
+        {
+            sqlite3_reset(m_stmt);
+            sqlite3_clear_bindings(m_stmt);
+            *m_inUse = false;
+        }
+        m_stmt = nullptr;
+    }
+};
+
+// Database is one SQLite connection with its pragma profile and a cache of prepared statements.
+// prepare() looks the SQL text up in the cache and only compiles it the first time, so a query run
+// in a loop is parsed and planned once. The cache keeps the most recently used statements: when it
+// is full, the one unused for longest is finalized (statements still borrowed are never evicted)
+class Database
+{
+public:
+    static constexpr size_t DefaultCacheCapacity = 64;
+
+    Database() = default;
+
+    explicit Database(const std::string& path, const PragmaProfile& profile = PragmaProfile(),
+                      int flags = SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE)
+    {
+        open(path, profile, flags);
+    }
+
+    ~Database()
+    {
+        close();
+    }
+
+    Database(const Database&) = delete;
+    Database& operator=(const Database&) = delete;
+
+    // Opens 'path' and applies 'profile'. Returns false, after reporting, if the file cannot be opened
+    bool open(const std::string& path, const PragmaProfile& profile = PragmaProfile(),
+              int flags = SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE)
+    {
+        close();
+        if (sqlite3_open_v2(path.c_str(), &m_db, flags, nullptr) != SQLITE_OK)
+        {
+            std::cerr << "Error opening database: " << sqlite3_errmsg(m_db) << std::endl;
+            close();
+            return false;
+        }
+        applyProfile(profile);
+        return true;
+    }
+
+    // Finalizes the cached statements and closes the connection
+    void close()
+    {
+        for (auto& entry : m_statements)
+        {
+            sqlite3_finalize(entry.stmt);
+        }
+        m_statements.clear();
+        m_index.clear();
+        sqlite3_close(m_db);
+        m_db = nullptr;
+    }
+
+    bool isOpen() const { return m_db != nullptr; }
+    sqlite3* handle() const { return m_db; }
+
+    // Sets the pragmas of 'profile' that differ from SQLite's defaults. journal_mode=WAL persists in the
+    // file; the others apply to this connection only
+    bool applyProfile(const PragmaProfile& profile)
+    {
+        std::string pragmas;
+        if (profile.busyTimeoutMs > 0)
+            pragmas += "PRAGMA busy_timeout = " + std::to_string(profile.busyTimeoutMs) + ";";
+        if (profile.wal)
+            pragmas += "PRAGMA journal_mode = WAL; PRAGMA synchronous = NORMAL;";
+        if (profile.mmapSize > 0)
+            pragmas += "PRAGMA mmap_size = " + std::to_string(profile.mmapSize) + ";";
+        if (profile.cacheKiB > 0)
+            pragmas += "PRAGMA cache_size = -" + std::to_string(profile.cacheKiB) + ";";
+        if (profile.tempInMemory)
+            pragmas += "PRAGMA temp_store = MEMORY;";
+        return pragmas.empty() || execute(pragmas);
+    }
+
+    // Runs one or more SQL statements that return no rows, reporting any error
+    bool execute(const std::string& sql)
+    {
+        char* errMsg = nullptr;
+        if (sqlite3_exec(m_db, sql.c_str(), nullptr, nullptr, &errMsg) != SQLITE_OK)
+        {
+            std::cerr << "SQL error: " << (errMsg ? errMsg : sqlite3_errmsg(m_db)) << std::endl;
+            sqlite3_free(errMsg);
+            return false;
+        }
+        return true;
+    }
+
+    // Runs a query returning a single integer, or 0 if it returns NULL or fails
+    int64_t queryInt(std::string_view sql)
+    {
+        Statement stmt = prepare(sql);
+        return stmt.step() ? stmt.column<int64_t>(0) : 0;
+    }
+
+    // Returns the cached statement for 'sql', compiling it on first use. If that statement is already
+    // borrowed (a query nested in a loop over itself), a separate one is prepared for this caller
+    Statement prepare(std::string_view sql)
+    {
+        auto found = m_index.find(sql);
+        if (found != m_index.end())
+        {
+            ++m_hits;
+            auto entry = found->second;
+            if (!entry->inUse)
+            {
+                m_statements.splice(m_statements.begin(), m_statements, entry);
+                entry->inUse = true;
+                return Statement(entry->stmt, &entry->inUse, false);
+            }
+            return Statement(compile(sql, 0), nullptr, true);
+        }
+
+        ++m_misses;
+        sqlite3_stmt* stmt = compile(sql, SQLITE_PREPARE_PERSISTENT);
+        if (!stmt)
+        {
+            return Statement();
+        }
+        m_statements.push_front(Entry{ std::string(sql), stmt, true });
+        m_index.emplace(m_statements.front().sql, m_statements.begin());
+        evict();
+        return Statement(stmt, &m_statements.front().inUse, false);
+    }
+
+    // Number of statements kept, and how many prepare() calls found their statement cached
+    void setCacheCapacity(size_t capacity)
+    {
+        m_capacity = capacity;
+        evict();
+    }
+
+    size_t cacheHits() const { return m_hits; }
+    size_t cacheMisses() const { return m_misses; }
+
+private:
+    struct Entry
+    {
+        std::string sql;
+        sqlite3_stmt* stmt;
+        bool inUse;
+    };
+
+    sqlite3* m_db{ nullptr };
+    std::list<Entry> m_statements;      // Most recently used first
+    std::unordered_map<std::string_view, std::list<Entry>::iterator> m_index;     // Keys point into the entries
+    size_t m_capacity{ DefaultCacheCapacity };
+    size_t m_hits{ 0 };
+    size_t m_misses{ 0 };
+
+    sqlite3_stmt* compile(std::string_view sql, unsigned int flags)
+    {
+        sqlite3_stmt* stmt = nullptr;
+        if (sqlite3_prepare_v3(m_db, sql.data(), static_cast<int>(sql.size()), flags, &stmt, nullptr) != SQLITE_OK)
+        {
+            std::cerr << "Error preparing statement: " << sqlite3_errmsg(m_db) << std::endl;
+            sqlite3_finalize(stmt);
+            return nullptr;
+        }
+        return stmt;
+    }
+
+    // Finalizes the least recently used statements that are not borrowed until the cache fits
+    void evict()
+    {
+        auto entry = m_statements.end();
+        while (m_statements.size() > m_capacity && entry != m_statements.begin())
+        {
+            --entry;
+            if (entry->inUse)
+            {
+                continue;
+            }
+            sqlite3_finalize(entry->stmt);
+            m_index.erase(entry->sql);
+            entry = m_statements.erase(entry);
+        }
+    }
+};
+
+// Transaction begins a transaction on construction and rolls it back on destruction unless it was
+// committed, so an early return or an exception never leaves a transaction open
+class Transaction
+{
+public:
+    // 'immediate' takes the write lock at once (BEGIN IMMEDIATE) instead of at the first write, so a
+    // writer waiting for another cannot fail halfway through
+    explicit Transaction(Database& db, bool immediate = false) : m_db(db), m_immediate(immediate)
+    {
+        begin();
+    }
+
+    ~Transaction()
+    {
+        if (m_active)
+        {
+            m_db.execute("ROLLBACK;");
+        }
+    }
+
+    Transaction(const Transaction&) = delete;
+    Transaction& operator=(const Transaction&) = delete;
+
+    // Commits the transaction. A COMMIT that fails (SQLITE_BUSY, a full disk) leaves the transaction
+    // open, so it is rolled back here: the work is lost and reported, and the connection can begin again
+    bool commit()
+    {
+        if (!m_active)
+        {
+            return false;
+        }
+        m_active = false;
+        if (m_db.execute("COMMIT;"))
+        {
+            return true;
+        }
+        if (!sqlite3_get_autocommit(m_db.handle()))
+        {
+            m_db.execute("ROLLBACK;");
+        }
+        return false;
+    }
+
+    // Commits the work so far and begins a new transaction, for loads committed in batches
+    bool commitBatch()
+    {
+        return commit() && begin();
+    }
+
+private:
+    Database& m_db;
+    bool m_immediate;
+    bool m_active{ false };
+
+    bool begin()
+    {
+        m_active = m_db.execute(m_immediate ? "BEGIN IMMEDIATE;" : "BEGIN;");
+        return m_active;
+    }
+};
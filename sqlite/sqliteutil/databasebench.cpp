@@ -0,0 +1,186 @@
+#include <iostream>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "database.h"
+#include "tablerenderer.h"
+
+namespace fs = std::filesystem;
+
+// Measures what each PragmaProfile costs or gains on the work the SQLite tools do: bulk inserts in
+// batched transactions, one commit per row (as the interactive menus do), lookups by key through the
+// statement cache and through a fresh prepare each time, and a grouped query that needs a temporary
+// sort. Besides the named profiles, each pragma is also measured on its own on top of WAL. Every
+// profile starts from a new database file
+
+namespace
+{
+    struct Timer
+    {
+        std::chrono::steady_clock::time_point start{ std::chrono::steady_clock::now() };
+
+        // Operations per second for 'count' operations since the timer started
+        double rate(size_t count) const
+        {
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            return seconds > 0 ? static_cast<double>(count) / seconds : 0.0;
+        }
+    };
+
+    std::string formatRate(double rate)
+    {
+        char text[32];
+        std::snprintf(text, sizeof(text), "%.0f", rate);
+        return text;
+    }
+
+    void removeDatabase(const std::string& path)
+    {
+        std::error_code error;
+        for (const char* suffix : { "", "-wal", "-shm", "-journal" })
+        {
+            fs::remove(path + suffix, error);
+        }
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    size_t rows = 200000;
+    std::string path = "databasebench.db";
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--rows" && i + 1 < argc)
+        {
+            rows = std::max<size_t>(1000, std::stoul(argv[++i]));
+        }
+        else if (arg == "--db" && i + 1 < argc)
+        {
+            path = argv[++i];
+        }
+        else
+        {
+            std::cerr << "Usage: " << argv[0] << " [--rows N] [--db FILE]" << std::endl;
+            return 1;
+        }
+    }
+
+    const size_t BatchSize = 10000;
+    const size_t SingleCommits = 500;
+    const size_t Lookups = rows;
+    const size_t UncachedLookups = rows / 10;
+
+    TableRenderer results({ { "Profile" }, { "Batched inserts/s", true }, { "Single commits/s", true }, { "Cached lookups/s", true },
+                            { "Uncached lookups/s", true }, { "Group-by sorts/s", true } },
+                          TableFormat::Table);
+    std::mt19937_64 random(42);
+
+    std::vector<PragmaProfile> profiles = PragmaProfile::all();
+    for (int pragma = 0; pragma < 3; ++pragma)
+    {
+        PragmaProfile profile = PragmaProfile::walJournal();
+        if (pragma == 0)
+            profile.mmapSize = PragmaProfile::fast().mmapSize;
+        else if (pragma == 1)
+            profile.cacheKiB = PragmaProfile::fast().cacheKiB;
+        else
+            profile.tempInMemory = true;
+        profile.name = pragma == 0 ? "wal+mmap" : pragma == 1 ? "wal+cache" : "wal+temp_store";
+        profiles.push_back(profile);
+    }
+
+    for (const auto& profile : profiles)
+    {
+        removeDatabase(path);
+        Database db(path, profile);
+        if (!db.isOpen())
+        {
+            return 1;
+        }
+        db.execute("CREATE TABLE bench (id INTEGER PRIMARY KEY, name TEXT, value REAL);"
+                   "CREATE INDEX idx_bench_name ON bench (name);");
+        std::cout << "Profile " << profile.name << "..." << std::endl;
+
+        // Names are random so that the index is updated all over, as with real titles and categories
+        Timer batched;
+        {
+            Transaction transaction(db);
+            char name[32];
+            for (size_t i = 0; i < rows; ++i)
+            {
+                std::snprintf(name, sizeof(name), "name-%016llx", static_cast<unsigned long long>(random()));
+                db.prepare("INSERT INTO bench (name, value) VALUES (?1, ?2);").bind(1, name).bind(2, static_cast<double>(i)).execute();
+                if ((i + 1) % BatchSize == 0)
+                {
+                    transaction.commitBatch();
+                }
+            }
+            transaction.commit();
+        }
+        double batchedRate = batched.rate(rows);
+
+        Timer single;
+        for (size_t i = 0; i < SingleCommits; ++i)
+        {
+            db.prepare("INSERT INTO bench (name, value) VALUES (?1, ?2);").bind(1, "single").bind(2, static_cast<double>(i)).execute();
+        }
+        double singleRate = single.rate(SingleCommits);
+
+        std::uniform_int_distribution<int64_t> anyId(1, static_cast<int64_t>(rows));
+        double sum = 0.0;
+        Timer cached;
+        for (size_t i = 0; i < Lookups; ++i)
+        {
+            Statement stmt = db.prepare("SELECT value FROM bench WHERE id = ?1;");
+            stmt.bind(1, anyId(random));
+            sum += stmt.step() ? stmt.column<double>(0) : 0.0;
+        }
+        double cachedRate = cached.rate(Lookups);
+
+        Timer uncached;
+        for (size_t i = 0; i < UncachedLookups; ++i)
+        {
+            sqlite3_stmt* stmt = nullptr;
+            sqlite3_prepare_v2(db.handle(), "SELECT value FROM bench WHERE id = ?1;", -1, &stmt, nullptr);
+            sqlite3_bind_int64(stmt, 1, anyId(random));
+            sum += sqlite3_step(stmt) == SQLITE_ROW ? sqlite3_column_double(stmt, 0) : 0.0;
+            sqlite3_finalize(stmt);
+        }
+        double uncachedRate = uncached.rate(UncachedLookups);
+
+        // Grouping on an expression no index covers makes SQLite build and sort a temporary b-tree
+        const size_t Sorts = 5;
+        Timer sorts;
+        for (size_t i = 0; i < Sorts; ++i)
+        {
+            Statement stmt = db.prepare("SELECT substr(name, 6, 3) AS prefix, COUNT(*), SUM(value) FROM bench GROUP BY prefix ORDER BY 3 DESC;");
+            while (stmt.step())
+            {
+                sum += stmt.column<double>(2);
+            }
+        }
+        double sortRate = sorts.rate(Sorts);
+
+        results.addCell(profile.name);
+        results.addCell(formatRate(batchedRate));
+        results.addCell(formatRate(singleRate));
+        results.addCell(formatRate(cachedRate));
+        results.addCell(formatRate(uncachedRate));
+        results.addCell(formatRate(sortRate));
+        if (sum < 0)
+        {
+            std::cout << sum << std::endl;      // Keeps the lookups from being optimised away
+        }
+        db.close();
+        removeDatabase(path);
+    }
+
+    std::cout << "\n" << rows << " rows, batches of " << BatchSize << ", " << SingleCommits << " single-row commits\n";
+    results.flush(std::cout);
+    return 0;
+}
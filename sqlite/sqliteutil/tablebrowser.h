@@ -0,0 +1,131 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <string>
+
+extern "C"
+{
+    #include <sqlite3.h>
+    #include <unistd.h>
+}
+
+#include "tablerenderer.h"
+
+// How a table is shown by TableBrowser
+struct BrowseOptions
+{
+    TableFormat format{ TableFormat::Table };
+    size_t pageSize{ 50 };              // Rows per page
+    int64_t after{ INT64_MIN };         // Start after this key
+    bool interactive{ true };           // Prompt between pages (only on a terminal)
+};
+
+// TableBrowser pages through a table in key order with keyset pagination: each page is fetched with
+// "WHERE id > last ORDER BY id LIMIT n" (or "id < first" going back), which is one seek in the primary
+// key however deep into the table the page lies, unlike OFFSET which reads every row it skips. The two
+// statements are prepared once and rebound for every page. Interactively the user steps forwards and
+// backwards a page at a time; otherwise (or when output goes to a pipe) all pages are streamed
+class TableBrowser
+{
+public:
+    // Fills the renderer with the cells of the current row of the statement
+    using RowFormatter = std::function<void(sqlite3_stmt*, TableRenderer&)>;
+
+    // 'columns' is the select list, and its first column must be the integer key 'key' of 'table'
+    TableBrowser(sqlite3* db, const std::string& table, const std::string& key, const std::string& columns,
+                 TableRenderer& renderer, RowFormatter formatRow)
+        : m_renderer(renderer), m_formatRow(std::move(formatRow))
+    {
+        std::string forward = "SELECT " + columns + " FROM " + table + " WHERE " + key + " > ?1 ORDER BY " + key + " LIMIT ?2;";
+        std::string backward = "SELECT * FROM (SELECT " + columns + " FROM " + table + " WHERE " + key + " < ?1 ORDER BY " +
+                               key + " DESC LIMIT ?2) ORDER BY 1;";
+        if (sqlite3_prepare_v2(db, forward.c_str(), -1, &m_forward, nullptr) != SQLITE_OK ||
+            sqlite3_prepare_v2(db, backward.c_str(), -1, &m_backward, nullptr) != SQLITE_OK)
+        {
+            std::cerr << "Error preparing page query: " << sqlite3_errmsg(db) << std::endl;
+        }
+    }
+
+    ~TableBrowser()
+    {
+        sqlite3_finalize(m_forward);
+        sqlite3_finalize(m_backward);
+    }
+
+    TableBrowser(const TableBrowser&) = delete;
+    TableBrowser& operator=(const TableBrowser&) = delete;
+
+    // Shows pages of rows starting after key 'options.after'. Prompts between pages when asked to and
+    // both standard input and output are terminals
+    void run(const BrowseOptions& options)
+    {
+        if (m_forward == nullptr || m_backward == nullptr)
+        {
+            return;
+        }
+        bool interactive = options.interactive && ::isatty(STDIN_FILENO) && ::isatty(STDOUT_FILENO);
+        size_t pageSize = std::max<size_t>(options.pageSize, 1);
+        m_last = options.after;
+
+        bool forward = true;
+        while (true)
+        {
+            size_t rows = forward ? fetch(m_forward, m_last, pageSize) : fetch(m_backward, m_first, pageSize);
+            if (rows > 0)
+            {
+                m_renderer.flush(std::cout);
+            }
+            if (!interactive)
+            {
+                if (rows < pageSize)
+                {
+                    return;
+                }
+                continue;
+            }
+
+            if (rows == 0)
+            {
+                std::cout << (forward ? "End of table.\n" : "Start of table.\n");
+            }
+            std::cout << "[Enter] next page, [p] previous page, [q] quit: " << std::flush;
+            std::string answer;
+            if (!std::getline(std::cin, answer) || answer == "q")
+            {
+                return;
+            }
+            forward = answer != "p";
+        }
+    }
+
+private:
+    TableRenderer& m_renderer;
+    RowFormatter m_formatRow;
+    sqlite3_stmt* m_forward{ nullptr };
+    sqlite3_stmt* m_backward{ nullptr };
+    int64_t m_first{ INT64_MIN };       // Keys of the first and last row shown
+    int64_t m_last{ INT64_MIN };
+
+    // Runs one page query and hands its rows to the renderer. Returns the number of rows
+    size_t fetch(sqlite3_stmt* stmt, int64_t bound, size_t pageSize)
+    {
+        sqlite3_bind_int64(stmt, 1, bound);
+        sqlite3_bind_int64(stmt, 2, static_cast<int64_t>(pageSize));
+        size_t rows = 0;
+        while (sqlite3_step(stmt) == SQLITE_ROW)
+        {
+            int64_t key = sqlite3_column_int64(stmt, 0);
+            if (rows++ == 0)
+            {
+                m_first = key;
+            }
+            m_last = key;
+            m_formatRow(stmt, m_renderer);
+        }
+        sqlite3_reset(stmt);
+        return rows;
+    }
+};
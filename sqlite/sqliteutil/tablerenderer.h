@@ -0,0 +1,214 @@
+#pragma once
+
+#include <algorithm>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Output formats of TableRenderer. Table is for reading on a terminal; CSV (RFC 4180) and TSV are for
+// piping into other programs, and carry no padding or rules
+enum class TableFormat
+{
+    Table,
+    Csv,
+    Tsv
+};
+
+// Parses "table", "csv" or "tsv". Returns false for anything else
+inline bool parseTableFormat(const std::string& text, TableFormat& format)
+{
+    if (text == "table")
+        format = TableFormat::Table;
+    else if (text == "csv")
+        format = TableFormat::Csv;
+    else if (text == "tsv")
+        format = TableFormat::Tsv;
+    else
+        return false;
+    return true;
+}
+
+// TableRenderer collects one page of rows and writes it with a single call. Column widths are computed
+// from the page itself, so a page of short values is not padded for the longest value in the table, and
+// nothing is flushed per row. The cell strings are reused from page to page
+class TableRenderer
+{
+public:
+    struct Column
+    {
+        std::string header;
+        bool alignRight{ false };
+    };
+
+    static constexpr size_t MaxCellWidth = 40;     // Longer cells are cut short in Table format
+
+    TableRenderer(std::vector<Column> columns, TableFormat format) : m_columns(std::move(columns)), m_format(format)
+    {
+    }
+
+    // Appends the next cell; rows are filled left to right
+    void addCell(std::string_view text)
+    {
+        if (m_count == m_cells.size())
+        {
+            m_cells.emplace_back();
+        }
+        m_cells[m_count++].assign(text.data(), text.size());
+    }
+
+    size_t rows() const { return m_count / m_columns.size(); }
+
+    // Writes the collected rows and starts a new page. In CSV and TSV formats the header is only written
+    // before the first page, so consecutive pages form one document
+    void flush(std::ostream& out)
+    {
+        m_buffer.clear();
+        if (m_format == TableFormat::Table)
+        {
+            renderTable();
+        }
+        else
+        {
+            renderDelimited(m_format == TableFormat::Csv ? ',' : '\t');
+        }
+        out.write(m_buffer.data(), static_cast<std::streamsize>(m_buffer.size()));
+        out.flush();
+        m_count = 0;
+        m_firstPage = false;
+    }
+
+private:
+    std::vector<Column> m_columns;
+    TableFormat m_format;
+    std::vector<std::string> m_cells;
+    size_t m_count{ 0 };
+    bool m_firstPage{ true };
+    std::string m_buffer;
+
+    // Display width of UTF-8 text: continuation bytes take no column
+    static size_t displayWidth(std::string_view text)
+    {
+        return static_cast<size_t>(std::count_if(text.begin(), text.end(),
+                                                  [](char c) { return (static_cast<unsigned char>(c) & 0xC0) != 0x80; }));
+    }
+
+    // Appends 'text' padded (or cut, ending in "...") to 'width' columns
+    void appendPadded(std::string_view text, size_t width, bool alignRight)
+    {
+        size_t length = displayWidth(text);
+        if (length > width)
+        {
+            // Cut at a character boundary, leaving room for the ellipsis
+            size_t keep = 0;
+            for (size_t columns = 0; keep < text.size(); ++keep)
+            {
+                if ((static_cast<unsigned char>(text[keep]) & 0xC0) != 0x80 && columns++ == width - 3)
+                {
+                    break;
+                }
+            }
+            m_buffer.append(text.data(), keep).append("...");
+            return;
+        }
+        if (alignRight)
+        {
+            m_buffer.append(width - length, ' ');
+        }
+        m_buffer.append(text.data(), text.size());
+        if (!alignRight)
+        {
+            m_buffer.append(width - length, ' ');
+        }
+    }
+
+    void renderTable()
+    {
+        size_t columnCount = m_columns.size();
+        std::vector<size_t> widths(columnCount);
+        for (size_t c = 0; c < columnCount; ++c)
+        {
+            widths[c] = displayWidth(m_columns[c].header);
+        }
+        for (size_t i = 0; i < m_count; ++i)
+        {
+            size_t& width = widths[i % columnCount];
+            width = std::max(width, std::min(displayWidth(m_cells[i]), MaxCellWidth));
+        }
+
+        size_t totalWidth = 1;
+        for (size_t width : widths)
+        {
+            totalWidth += width + 3;
+        }
+        std::string rule(totalWidth, '-');
+
+        auto appendRow = [&](auto cellText)
+        {
+            m_buffer += "|";
+            for (size_t c = 0; c < columnCount; ++c)
+            {
+                m_buffer += ' ';
+                appendPadded(cellText(c), widths[c], m_columns[c].alignRight);
+                m_buffer += " |";
+            }
+            m_buffer += '\n';
+        };
+
+        m_buffer.append(rule).append("\n");
+        appendRow([&](size_t c) -> std::string_view { return m_columns[c].header; });
+        m_buffer.append(rule).append("\n");
+        for (size_t row = 0; row < rows(); ++row)
+        {
+            appendRow([&](size_t c) -> std::string_view { return m_cells[row * columnCount + c]; });
+        }
+        m_buffer.append(rule).append("\n");
+    }
+
+    void renderDelimited(char delimiter)
+    {
+        size_t columnCount = m_columns.size();
+        auto appendField = [&](std::string_view text, bool last)
+        {
+            if (delimiter == ',')
+            {
+                if (text.find_first_of(",\"\r\n") == std::string_view::npos)
+                {
+                    m_buffer.append(text.data(), text.size());
+                }
+                else
+                {
+                    m_buffer += '"';
+                    for (char c : text)
+                    {
+                        if (c == '"')
+                            m_buffer += '"';
+                        m_buffer += c;
+                    }
+                    m_buffer += '"';
+                }
+            }
+            else
+            {
+                // TSV has no quoting: tabs and line breaks inside a value become spaces
+                for (char c : text)
+                {
+                    m_buffer += (c == '\t' || c == '\n' || c == '\r') ? ' ' : c;
+                }
+            }
+            m_buffer += last ? '\n' : delimiter;
+        };
+
+        if (m_firstPage)
+        {
+            for (size_t c = 0; c < columnCount; ++c)
+            {
+                appendField(m_columns[c].header, c + 1 == columnCount);
+            }
+        }
+        for (size_t i = 0; i < m_count; ++i)
+        {
+            appendField(m_cells[i], i % columnCount + 1 == columnCount);
+        }
+    }
+};